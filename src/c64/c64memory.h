@@ -49,7 +49,7 @@ class Sid;
  * - @c $DE00-$DFFF  Page 222-223  Reserved for interface extensions
  * - @c $E000-$FFFF  Page 224-255  Free machine language program storage area (when switched-out with ROM)
  */
-class C64Memory: public Memory
+class C64Memory final : public Memory
 {
   private:
     uint8_t *mem_ram_;
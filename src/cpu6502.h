@@ -1,25 +1,325 @@
-#include <cstdio>
+#ifndef EMUDORE_SRC_CPU6502_H
+#define EMUDORE_SRC_CPU6502_H
+#include <functional>
 #include <cstdint>
-#include <inttypes.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cinttypes>
+#include <memory>
+#include <string>
 #include <gflags/gflags.h>
-#include "src/cpu2.h"
 #include "src/pbmacro.h"
+#include "proto/cpu6502.pb.h"
+
+DECLARE_bool(trace);
+
+// Machine specific behavior of the 6502 core.  Each machine instantiates
+// the core with one of these as its Model parameter.
+//
+// The MOS 6510 (Commodore 64) has a working decimal mode.  The CIAs and
+// VIC re-assert their interrupt lines until acknowledged, so an IRQ raised
+// while the I flag is set is simply dropped.  Programs commonly wait for
+// an interrupt with a branch to itself.
+struct Mos6510 {
+    static const bool kDecimalMode = true;
+    static const bool kLatchMaskedIrq = false;
+    static const bool kTrapBranchToSelf = false;
+};
+
+// The Ricoh 2A03 (NES) has the decimal flag, but the BCD adder was
+// disconnected, so ADC/SBC always operate in binary.  The APU and mappers
+// raise IRQ once, so it stays pending until the I flag is cleared.  A
+// branch to itself taken twice in a row aborts, to catch a runaway CPU.
+struct Ricoh2A03 {
+    static const bool kDecimalMode = false;
+    static const bool kLatchMaskedIrq = true;
+    static const bool kTrapBranchToSelf = true;
+};
+
+// Non-templated parts of the 6502 core: register layouts and the
+// instruction tables.
+class Cpu6502Base {
+  public:
+    union CpuFlags {
+        uint8_t value;
+        struct {
+            uint8_t c:1;
+            uint8_t z:1;
+            uint8_t i:1;
+            uint8_t d:1;
+            uint8_t b:1;
+            uint8_t u:1;
+            uint8_t v:1;
+            uint8_t n:1;
+        };
+    };
+
+    union InstructionInfo {
+        uint16_t value;
+        struct {
+            uint16_t mode:4;
+            uint16_t size:4;
+            uint16_t cycles:4;
+            uint16_t page:4;
+        };
+    };
+
+    // Kinds of CPU reads, passed to Bus::access_hint() ahead of the reads
+    // they describe.
+    enum Access {
+        kFetch,             // Opcodes and operands.
+        kFetchIndirect,     // An opcode reached through JMP (nnnn).
+        kData,
+        kDataIndirect,      // Data read through (nn,X) or (nn),Y.
+    };
+
+    enum AddressingMode {
+        Absolute,
+        AbsoluteX,
+        AbsoluteY,
+        Accumulator,
+        Immediate,
+        Implied,
+        IndexedIndirect,
+        Indirect,
+        IndirectIndexed,
+        Relative,
+        ZeroPage,
+        ZeroPageX,
+        ZeroPageY,
+    };
+
+    static inline InstructionInfo info(uint8_t opcode) {
+        return info_[opcode];
+    }
+    static inline const char* instruction_name(uint8_t opcode) {
+        return instruction_names_[opcode];
+    }
+
+  protected:
+    static const InstructionInfo info_[256];
+    static const char* instruction_names_[256];
+};
+
+// A 6502 core templated on the machine's memory bus.
+//
+// The Bus must provide read_byte(addr), write_byte(addr, val) and
+// access_hint(kind); Memory supplies a no-op access_hint.  Since the
+// core knows the concrete bus type, calls to a final Bus class are resolved
+// at compile time rather than through the Memory vtable.
+template<class Bus, class Model>
+class Cpu6502 : public Cpu6502Base {
+  public:
+    Cpu6502() : Cpu6502(nullptr) {}
+    Cpu6502(Bus* mem);
+
+    void SaveState(proto::CPU6502 *state);
+    void LoadState(proto::CPU6502 *state);
+    void Reset();
+    int Emulate();
+    std::string Disassemble(uint16_t *nexti=nullptr, bool tracemode=false);
+    std::string CpuState();
+    inline void NMI() {
+        nmi_pending_ = true;
+        Emit("NMI");
+    }
+    inline void IRQ() {
+        if (!Model::kLatchMaskedIrq && flags_.i)
+            return;
+        irq_pending_ = true;
+        Emit("IRQ");
+    }
+
+    inline void reset() { Reset(); }
+    inline bool emulate() { Emulate(); return !halted_; }
+    inline void nmi() { NMI(); }
+    inline void irq() { IRQ(); }
+    inline void memory(Bus* mem) { mem_ = mem; }
+    inline Bus* memory() { return mem_; }
+
+    inline unsigned int cycles() { return cycles_; }
+    // cycles() wraps after 2^32; this doesn't.
+    inline uint64_t cycles64() { return cycles_; }
+
+    inline uint8_t a() { return a_; }
+    inline uint8_t x() { return x_; }
+    inline uint8_t y() { return y_; }
+    inline uint8_t sp() { return sp_; }
+    inline uint8_t p() { return flags_.value; }
+    inline uint16_t pc() { return pc_; }
+    inline void pc(uint16_t pc) { pc_ = pc; }
+    inline void set_pc(uint16_t pc) { pc_ = pc; }
+
+    // The address and opcode of the most recently executed instruction and
+    // the interrupt vector taken just before it (0 if none).  retired()
+    // counts instructions, so callers can tell a stall from an instruction.
+    inline uint64_t retired() { return retired_; }
+    inline uint16_t last_pc() { return last_pc_; }
+    inline uint8_t last_opcode() { return last_opcode_; }
+    inline uint16_t last_interrupt() { return last_interrupt_; }
 
-DEFINE_bool(trace, false, "Enable per cycle CPU tracing");
+    inline bool cf() { return flags_.c; }
+    inline bool zf() { return flags_.z; }
+    inline bool idf() { return flags_.i; }
+    inline bool dmf() { return flags_.d; }
+    inline bool bcf() { return flags_.b; }
+    inline bool of() { return flags_.v; }
+    inline bool nf() { return flags_.n; }
 
-void Cpu::Branch(uint16_t addr) {
-    static uint16_t last_pc, last_addr;
-    if (pc_ == last_pc && addr == last_addr && addr == pc_ - 2)
-        abort();
-    last_pc = pc_; last_addr = addr;
+    inline void set_write_cb(std::function<void(Cpu6502*, uint16_t, uint8_t)> cb) {
+        write_cb_ = cb;
+    }
+    inline void set_exec_cb(std::function<void(Cpu6502*, uint16_t, uint8_t)> cb) {
+        exec_cb_ = cb;
+    }
+    inline void set_read_cb(std::function<void(Cpu6502*, uint16_t, uint8_t)> cb) {
+        read_cb_ = cb;
+    }
+  private:
+    uint8_t inline Read(uint16_t addr) {
+        uint8_t val = mem_->read_byte(addr);
+        if (read_cb_) read_cb_(this, addr, val);
+        return val;
+    }
+    void inline Write(uint16_t addr, uint8_t val) {
+        if (write_cb_) write_cb_(this, addr, val);
+        mem_->write_byte(addr, val);
+    }
+    uint16_t inline Read16(uint16_t addr) {
+        return Read(addr) | Read(addr+1) << 8;
+    }
+    uint16_t inline Read16Bug(uint16_t addr) {
+        // When reading the high byte of the word, the address
+        // increments, but doesn't carry from the low address byte to the
+        // high address byte.
+        uint16_t ret = Read(addr);
+        ret |= Read((addr & 0xFF00) | ((addr+1) & 0x00FF)) << 8;
+        return ret;
+    }
+
+    inline void Push(uint8_t val) { Write(sp_-- | 0x100, val); }
+    inline uint8_t Pull() { return Read(++sp_ | 0x100); }
+
+    inline void Push16(uint16_t val) { Push(val>>8); Push(val); }
+    inline uint16_t Pull16() { return Pull() | Pull() << 8; }
+
+    inline void SetZ(uint8_t val) { flags_.z = (val == 0); }
+    inline void SetN(uint8_t val) { flags_.n = !!(val & 0x80); }
+    inline void SetZN(uint8_t val) { SetZ(val); SetN(val); }
+    inline void Compare(uint8_t a, uint8_t b) {
+        SetZN(a - b);
+        flags_.c = (a >= b);
+    }
+    inline bool PagesDiffer(uint16_t a, uint16_t b) {
+        return (a & 0xFF00) != (b & 0xFF00);
+    }
+    void Branch(uint16_t addr);
+    void Interrupt(uint16_t vector);
+    void Adc(uint8_t b);
+    void Sbc(uint8_t b);
+
+    Bus* mem_;
+    CpuFlags flags_;
+    uint16_t pc_;
+    uint8_t sp_;
+    uint8_t a_, x_, y_;
+
+    uint64_t cycles_;
+    int stall_;
+    bool nmi_pending_;
+    bool irq_pending_;
+
+    uint64_t retired_;
+    uint16_t last_pc_;
+    uint8_t last_opcode_;
+    uint16_t last_interrupt_;
+    // The last branch taken, for Model::kTrapBranchToSelf.
+    uint16_t branch_pc_, branch_addr_;
+
+    void Flush();
+    void Emit(const char *buf, int how=0);
+    void Trace();
+
+    static const int TRACEBUFSZ = 1000000;
+    static const int SLOP = 1000;
+    // Allocated by the first Emit with --trace on.
+    std::unique_ptr<char[][80]> tracebuf_;
+    int tbptr_;
+    uint64_t last_ts_;
+    bool halted_;
+    std::function<void(Cpu6502*, uint16_t, uint8_t)> write_cb_;
+    std::function<void(Cpu6502*, uint16_t, uint8_t)> exec_cb_;
+    std::function<void(Cpu6502*, uint16_t, uint8_t)> read_cb_;
+};
+
+template<class Bus, class Model>
+void Cpu6502<Bus, Model>::Branch(uint16_t addr) {
+    if (Model::kTrapBranchToSelf) {
+        if (pc_ == branch_pc_ && addr == branch_addr_ && addr == pc_ - 2)
+            abort();
+        branch_pc_ = pc_; branch_addr_ = addr;
+    }
     if (PagesDiffer(pc_, addr))
         cycles_++;
     pc_ = addr;
     cycles_++;
 }
 
+template<class Bus, class Model>
+void Cpu6502<Bus, Model>::Interrupt(uint16_t vector) {
+    // Hardware interrupts push the flags with B clear; only BRK and PHP
+    // push it set.
+    Push16(pc_);
+    Push((flags_.value & 0xEF) | 0x20);
+    pc_ = Read16(vector);
+    flags_.i = true;
+    cycles_ += 7;
+    last_interrupt_ = vector;
+}
+
+template<class Bus, class Model>
+void Cpu6502<Bus, Model>::Adc(uint8_t b) {
+    uint8_t a = a_;
+    int16_t r;
+    if (Model::kDecimalMode && flags_.d) {
+        r = (a & 0xf) + (b & 0xf) + flags_.c;
+        if (r > 0x09)
+            r += 0x06;
+        r += (a & 0xf0) + (b & 0xf0);
+        if ((r & 0x1f0) > 0x90)
+            r += 0x60;
+    } else {
+        r = a + b + flags_.c;
+    }
+    a_ = r;
+    flags_.c = (r > 0xff);
+    flags_.v = ((a ^ b) & 0x80) == 0 && ((a ^ a_) & 0x80) != 0;
+    SetZN(a_);
+}
+
+template<class Bus, class Model>
+void Cpu6502<Bus, Model>::Sbc(uint8_t b) {
+    uint8_t a = a_;
+    int16_t r = a - b - (1 - flags_.c);
+    if (Model::kDecimalMode && flags_.d) {
+        uint16_t t = (a & 0xf) - (b & 0xf) - (1 - flags_.c);
+        if (t & 0x10)
+            t = ((t - 0x6) & 0xf) | ((a & 0xf0) - (b & 0xf0) - 0x10);
+        else
+            t = (t & 0xf) | ((a & 0xf0) - (b & 0xf0));
+        if (t & 0x100)
+            t -= 0x60;
+        a_ = t;
+    } else {
+        a_ = r;
+    }
+    flags_.c = (r >= 0);
+    flags_.v = ((a ^ r) & 0x80) != 0 && ((a ^ b) & 0x80) != 0;
+    SetZN(a_);
+}
 
-Cpu::Cpu(Memory* mem) :
+template<class Bus, class Model>
+Cpu6502<Bus, Model>::Cpu6502(Bus* mem) :
     mem_(mem),
     flags_{0x24},
     pc_(0),
@@ -29,20 +329,30 @@ Cpu::Cpu(Memory* mem) :
     stall_(0),
     nmi_pending_(false),
     irq_pending_(false),
+    retired_(0),
+    last_pc_(0),
+    last_opcode_(0),
+    last_interrupt_(0),
+    branch_pc_(0),
+    branch_addr_(0),
     tbptr_(0),
+    last_ts_(0),
     halted_(false) {}
 
-void Cpu::SaveState(proto::CPU6502 *state) {
+template<class Bus, class Model>
+void Cpu6502<Bus, Model>::SaveState(proto::CPU6502 *state) {
     state->set_flags(flags_.value);
     SAVE(pc, sp, a, x, y, cycles, stall, nmi_pending, irq_pending);
 }
 
-void Cpu::LoadState(proto::CPU6502 *state) {
+template<class Bus, class Model>
+void Cpu6502<Bus, Model>::LoadState(proto::CPU6502 *state) {
     flags_.value = state->flags();
     LOAD(pc, sp, a, x, y, cycles, stall, nmi_pending, irq_pending);
 }
 
-void Cpu::Reset() {
+template<class Bus, class Model>
+void Cpu6502<Bus, Model>::Reset() {
     pc_ = Read16(0xFFFC);
     sp_ = 0xFD;
 //    flags_.value = 0x24;
@@ -52,10 +362,12 @@ void Cpu::Reset() {
     irq_pending_ = false;
     cycles_ = 0;
     stall_ = 0;
+    halted_ = false;
     Emit("RESET");
 }
 
-std::string Cpu::CpuState() {
+template<class Bus, class Model>
+std::string Cpu6502<Bus, Model>::CpuState() {
     char buf[80];
     sprintf(buf, "PC=%04x A=%02x X=%02x Y=%02x SP=1%02x %c%c%c%c%c%c%c%c",
             pc_, a_, x_, y_, sp_,
@@ -70,7 +382,8 @@ std::string Cpu::CpuState() {
     return std::string(buf);
 }
 
-std::string Cpu::Disassemble(uint16_t* nexti, bool tracemode) {
+template<class Bus, class Model>
+std::string Cpu6502<Bus, Model>::Disassemble(uint16_t* nexti, bool tracemode) {
     char buf[80];
     char *b = buf;
     uint16_t data = 0;
@@ -125,37 +438,38 @@ std::string Cpu::Disassemble(uint16_t* nexti, bool tracemode) {
     return std::string(buf);
 }
 
-void Cpu::Flush() {
+template<class Bus, class Model>
+void Cpu6502<Bus, Model>::Flush() {
+    if (!tracebuf_)
+        return;
     for(int i=tbptr_+1; i != tbptr_; i=(i+1)%TRACEBUFSZ) {
         fputs(tracebuf_[i], stderr);
     }
 }
 
-void Cpu::Emit(const char *buf, int how) {
-    static uint64_t last_ts;
+template<class Bus, class Model>
+void Cpu6502<Bus, Model>::Emit(const char *buf, int how) {
     uint64_t ts = cycles_;
     if (!FLAGS_trace)
         return;
+    if (!tracebuf_)
+        tracebuf_.reset(new char[TRACEBUFSZ][80]());
     if (how < 0) {
         int n = -how;
         sprintf(tracebuf_[tbptr_], "%*s  %s\n", n, "", buf);
     } else if (how == 1) {
-        uint64_t dt = ts - last_ts;
+        uint64_t dt = ts - last_ts_;
         sprintf(tracebuf_[tbptr_], "%" PRIu64 ": %s\n", dt, buf);
-        last_ts = ts;
+        last_ts_ = ts;
     } else {
         sprintf(tracebuf_[tbptr_], "%" PRIu64 ": %s\n", ts, buf);
-        last_ts = ts;
+        last_ts_ = ts;
     }
     tbptr_ = (tbptr_ + 1) % TRACEBUFSZ;
-//    if (tbptr_ > TRACEBUFSZ) {
-//        Flush();
-//    }
 }
 
-
-
-void Cpu::Trace() {
+template<class Bus, class Model>
+void Cpu6502<Bus, Model>::Trace() {
     if (!FLAGS_trace)
         return;
     std::string s = CpuState();
@@ -163,7 +477,8 @@ void Cpu::Trace() {
     Disassemble(nullptr, true);
 }
 
-int Cpu::Emulate(void) {
+template<class Bus, class Model>
+int Cpu6502<Bus, Model>::Emulate(void) {
     if (halted_)
         return 1;
     if (stall_ > 0) {
@@ -171,62 +486,34 @@ int Cpu::Emulate(void) {
       return 1;
     }
     int cycles = cycles_;
+    last_interrupt_ = 0;
+    mem_->access_hint(kData);
 
     // Interrupt?
     if (nmi_pending_) {
-//        printf("NMI @ %d\n", cycles_);
         nmi_pending_ = false;
-        Push16(pc_);
-        Push(flags_.value | 0x10);
-        pc_ = Read16(0xFFFA);
-        flags_.i = true;
-        cycles_ += 7;
+        Interrupt(0xFFFA);
     } else if (irq_pending_ && !flags_.i) {
         irq_pending_ = false;
-        Push16(pc_);
-        Push(flags_.value | 0x10);
-        pc_ = Read16(0xFFFE);
-        flags_.i = true;
-        cycles_ += 7;
+        Interrupt(0xFFFE);
     }
 
     // Scratch values
-    uint8_t val, a, b;
+    uint8_t val, a;
     int16_t r;
 
     uint16_t fetchpc = pc_;
     uint16_t addr = 0;
+    mem_->access_hint(last_opcode_ == 0x6C && !last_interrupt_
+                      ? kFetchIndirect : kFetch);
     uint8_t opcode = Read(pc_);
     InstructionInfo info = info_[opcode];
+    retired_++;
+    last_pc_ = fetchpc;
+    last_opcode_ = opcode;
     Trace();
-    exec_cb_(this, pc_, opcode);
-
-#undef TESTCPU
-#ifdef TESTCPU
-    printf("      A=%02x X=%02x Y=%02x SP=1%02x %c%c%c%c%c%c%c%c\n",
-            a_, x_, y_, sp_,
-            flags_.n ? 'N' : 'n',
-            flags_.v ? 'V' : 'v',
-            flags_.u ? 'U' : 'u',
-            flags_.b ? 'B' : 'b',
-            flags_.d ? 'D' : 'd',
-            flags_.i ? 'I' : 'i',
-            flags_.z ? 'Z' : 'z',
-            flags_.c ? 'C' : 'c');
-    switch(info.size) {
-    case 1:
-        printf("%02x: %02x\n", pc_, opcode);
-        break;
-    case 2:
-        printf("%02x: %02x%02x\n", pc_, opcode, Read(pc_+1));
-        break;
-    case 3:
-        printf("%02x: %02x%02x%02x\n", pc_, opcode, Read(pc_+1), Read(pc_+2));
-        break;
-    }
-#endif
+    if (exec_cb_) exec_cb_(this, pc_, opcode);
 
-    //printf("Decoding instruction at %04x -> %02x\n", pc_, opcode);
     // Based on the AddressingMode of the instruction, compute the address
     // target to be used by the instruction.
     switch(AddressingMode(info.mode)) {
@@ -244,15 +531,14 @@ int Cpu::Emulate(void) {
             cycles_ += info.page;
         break;
     case IndexedIndirect:
-        //addr = Read16Bug(Read(pc_+1) + x_);
         addr = Read16((Read(pc_ + 1) + x()) & 0xff);
         break;
     case Indirect:
-        addr = Read16Bug(Read16(pc_+1));
+        addr = Read16(pc_+1);
+        mem_->access_hint(kData);
+        addr = Read16Bug(addr);
         break;
     case IndirectIndexed:
-        //addr = Read16Bug(Read(pc_+1)) + y_;
-        // Fixed?
         addr = Read16(Read(pc_ + 1)) + y();
         if (PagesDiffer(addr - y_, addr))
             cycles_ += info.page;
@@ -277,11 +563,17 @@ int Cpu::Emulate(void) {
         addr = pc_ + 2 + int8_t(Read(pc_ + 1));;
         break;
     }
+    switch(AddressingMode(info.mode)) {
+    case Immediate:
+        break;
+    case IndexedIndirect:
+    case IndirectIndexed:
+        mem_->access_hint(kDataIndirect);
+        break;
+    default:
+        mem_->access_hint(kData);
+    }
 
-#ifdef TESTCPU
-    printf("Computed address %04x via mode %d (%02x %02x)\n",
-            addr, info.mode, Read(addr), Read(addr+1));
-#endif
     pc_ += info.size;
     cycles_ += info.cycles;
 
@@ -496,13 +788,7 @@ int Cpu::Emulate(void) {
     case 0x79:
     /* ADC nnnn,X */
     case 0x7D:
-        a = a_;
-        b = Read(addr);
-        r = a + b + flags_.c;
-        a_ = r;
-        flags_.c = (r > 0xff);
-        flags_.v = ((a ^ b) & 0x80) == 0 && ((a ^ a_) & 0x80) != 0;
-        SetZN(a_);
+        Adc(Read(addr));
         break;
     /* ROR nn */
     case 0x66:
@@ -742,13 +1028,7 @@ int Cpu::Emulate(void) {
     case 0xF9:
     /* SBC nnnn,X */
     case 0xFD:
-        a = a_;
-        b = Read(addr);
-        r = a - b - (1- flags_.c);
-        a_ = r;
-        flags_.c = (r >= 0);
-        flags_.v = ((a ^ r) & 0x80) != 0 && ((a ^ b) & 0x80) != 0;
-        SetZN(a_);
+        Sbc(Read(addr));
         break;
     /* INC nn */
     case 0xE6:
@@ -787,319 +1067,4 @@ int Cpu::Emulate(void) {
     return cycles_ - cycles;
 }
 
-// Information about each instruction is encoded into the info_ table.
-// Each 4 bits means (from lowest to highest):
-//    AddressingMode
-//    Instruction Size (in bytes)
-//    Cyles
-//    Extra cycles when crossing a page boundary
-const Cpu::InstructionInfo Cpu::info_[256] = {
-    // 0x00      1       2       3       4       5       6       7
-    //    8      9       a       b       c       d       e       f
-    0x0715, 0x0626, 0x0205, 0x0806, 0x032a, 0x032a, 0x052a, 0x050a, 
-    0x0315, 0x0224, 0x0213, 0x0204, 0x0430, 0x0430, 0x0630, 0x0600, 
-    // 0x10
-    0x1229, 0x1528, 0x0205, 0x0808, 0x042b, 0x042b, 0x062b, 0x060b, 
-    0x0215, 0x1432, 0x0215, 0x0702, 0x1431, 0x1431, 0x0731, 0x0701, 
-    // 0x20
-    0x0630, 0x0626, 0x0205, 0x0806, 0x032a, 0x032a, 0x052a, 0x050a, 
-    0x0415, 0x0224, 0x0213, 0x0204, 0x0430, 0x0430, 0x0630, 0x0600, 
-    // 0x30
-    0x1229, 0x1528, 0x0205, 0x0808, 0x042b, 0x042b, 0x062b, 0x060b, 
-    0x0215, 0x1432, 0x0215, 0x0702, 0x1431, 0x1431, 0x0731, 0x0701, 
-    // 0x40
-    0x0615, 0x0626, 0x0205, 0x0806, 0x032a, 0x032a, 0x052a, 0x050a, 
-    0x0315, 0x0224, 0x0213, 0x0204, 0x0330, 0x0430, 0x0630, 0x0600, 
-    // 0x50
-    0x1229, 0x1528, 0x0205, 0x0808, 0x042b, 0x042b, 0x062b, 0x060b, 
-    0x0215, 0x1432, 0x0215, 0x0702, 0x1431, 0x1431, 0x0731, 0x0701, 
-    // 0x60
-    0x0615, 0x0626, 0x0205, 0x0806, 0x032a, 0x032a, 0x052a, 0x050a, 
-    0x0415, 0x0224, 0x0213, 0x0204, 0x0537, 0x0430, 0x0630, 0x0600, 
-    // 0x70
-    0x1229, 0x1528, 0x0205, 0x0808, 0x042b, 0x042b, 0x062b, 0x060b, 
-    0x0215, 0x1432, 0x0215, 0x0702, 0x1431, 0x1431, 0x0731, 0x0701, 
-    // 0x80
-    0x0224, 0x0626, 0x0204, 0x0606, 0x032a, 0x032a, 0x032a, 0x030a, 
-    0x0215, 0x0204, 0x0215, 0x0204, 0x0430, 0x0430, 0x0430, 0x0400, 
-    // 0x90
-    0x1229, 0x0628, 0x0205, 0x0608, 0x042b, 0x042b, 0x042c, 0x040c, 
-    0x0215, 0x0532, 0x0215, 0x0502, 0x0501, 0x0531, 0x0502, 0x0502, 
-    // 0xA0
-    0x0224, 0x0626, 0x0224, 0x0606, 0x032a, 0x032a, 0x032a, 0x030a, 
-    0x0215, 0x0224, 0x0215, 0x0204, 0x0430, 0x0430, 0x0430, 0x0400, 
-    // 0xB0
-    0x1229, 0x1528, 0x0205, 0x1508, 0x042b, 0x042b, 0x042c, 0x040c, 
-    0x0215, 0x1432, 0x0215, 0x1402, 0x1431, 0x1431, 0x1432, 0x1402, 
-    // 0xC0
-    0x0224, 0x0626, 0x0204, 0x0806, 0x032a, 0x032a, 0x052a, 0x050a, 
-    0x0215, 0x0224, 0x0215, 0x0204, 0x0430, 0x0430, 0x0630, 0x0600, 
-    // 0xD0
-    0x1229, 0x1528, 0x0205, 0x0808, 0x042b, 0x042b, 0x062b, 0x060b, 
-    0x0215, 0x1432, 0x0215, 0x0702, 0x1431, 0x1431, 0x0731, 0x0701, 
-    // 0xE0
-    0x0224, 0x0626, 0x0204, 0x0806, 0x032a, 0x032a, 0x052a, 0x050a, 
-    0x0215, 0x0224, 0x0215, 0x0204, 0x0430, 0x0430, 0x0630, 0x0600, 
-    // 0xF0
-    0x1229, 0x1528, 0x0205, 0x0808, 0x042b, 0x042b, 0x062b, 0x060b, 
-    0x0215, 0x1432, 0x0215, 0x0702, 0x1431, 0x1431, 0x0731, 0x0701, 
-};
-
-const char* Cpu::instruction_names_[] = {
-/* 00 */      "BRK",
-/* 01 */      "ORA ($%02x,X)",
-/* 02 */      "illop_02",
-/* 03 */      "illop_03",
-/* 04 */      "illop_04",
-/* 05 */      "ORA $%02x",
-/* 06 */      "ASL $%02x",
-/* 07 */      "illop_07",
-/* 08 */      "PHP",
-/* 09 */      "ORA #$%02x",
-/* 0a */      "ASL A",
-/* 0b */      "illop_0b",
-/* 0c */      "illop_0c",
-/* 0d */      "ORA $%04x",
-/* 0e */      "ASL $%04x",
-/* 0f */      "illop_0f",
-/* 10 */      "BPL $%02x",
-/* 11 */      "ORA ($%02x,Y)",
-/* 12 */      "illop_12",
-/* 13 */      "illop_13",
-/* 14 */      "illop_14",
-/* 15 */      "ORA $%02x,X",
-/* 16 */      "ASL $%02x,X",
-/* 17 */      "illop_17",
-/* 18 */      "CLC",
-/* 19 */      "ORA $%04x,Y",
-/* 1a */      "illop_1a",
-/* 1b */      "illop_1b",
-/* 1c */      "illop_1c",
-/* 1d */      "ORA $%04x,X",
-/* 1e */      "ASL $%04x,X",
-/* 1f */      "illop_1f",
-/* 20 */      "JSR $%04x",
-/* 21 */      "AND ($%02x,X)",
-/* 22 */      "illop_22",
-/* 23 */      "illop_23",
-/* 24 */      "BIT $%02x",
-/* 25 */      "AND $%02x",
-/* 26 */      "ROL $%02x",
-/* 27 */      "illop_27",
-/* 28 */      "PLP",
-/* 29 */      "AND #$%02x",
-/* 2a */      "ROL A",
-/* 2b */      "illop_2b",
-/* 2c */      "BIT $%04x",
-/* 2d */      "AND $%04x",
-/* 2e */      "ROL $%04x",
-/* 2f */      "illop_2f",
-/* 30 */      "BMI $%02x",
-/* 31 */      "AND ($%02x,Y)",
-/* 32 */      "illop_32",
-/* 33 */      "illop_33",
-/* 34 */      "illop_34",
-/* 35 */      "AND $%02x,X",
-/* 36 */      "ROL $%02x,X",
-/* 37 */      "illop_37",
-/* 38 */      "SEC",
-/* 39 */      "AND $%04x,Y",
-/* 3a */      "illop_3a",
-/* 3b */      "illop_3b",
-/* 3c */      "illop_3c",
-/* 3d */      "AND $%04x,X",
-/* 3e */      "ROL $%04x,X",
-/* 3f */      "illop_3f",
-/* 40 */      "RTI",
-/* 41 */      "EOR ($%02x,X)",
-/* 42 */      "illop_42",
-/* 43 */      "illop_43",
-/* 44 */      "illop_44",
-/* 45 */      "EOR $%02x",
-/* 46 */      "LSR $%02x",
-/* 47 */      "illop_47",
-/* 48 */      "PHA",
-/* 49 */      "EOR #$%02x",
-/* 4a */      "LSR A",
-/* 4b */      "illop_4b",
-/* 4c */      "JMP $%04x",
-/* 4d */      "EOR $%04x",
-/* 4e */      "LSR $%04x",
-/* 4f */      "illop_4f",
-/* 50 */      "BVC",
-/* 51 */      "EOR ($%02x,Y)",
-/* 52 */      "illop_52",
-/* 53 */      "illop_53",
-/* 54 */      "illop_54",
-/* 55 */      "EOR $%02x,X",
-/* 56 */      "LSR $%02x,X",
-/* 57 */      "illop_57",
-/* 58 */      "CLI",
-/* 59 */      "EOR $%04x,Y",
-/* 5a */      "illop_5a",
-/* 5b */      "illop_5b",
-/* 5c */      "illop_5c",
-/* 5d */      "EOR $%04x,X",
-/* 5e */      "LSR $%04x,X",
-/* 5f */      "illop_5f",
-/* 60 */      "RTS",
-/* 61 */      "ADC ($%02x,X)",
-/* 62 */      "illop_62",
-/* 63 */      "illop_63",
-/* 64 */      "illop_64",
-/* 65 */      "ADC $%02x",
-/* 66 */      "ROR $%02x",
-/* 67 */      "illop_67",
-/* 68 */      "PLA",
-/* 69 */      "ADC #$%02x",
-/* 6a */      "ROR A",
-/* 6b */      "illop_6b",
-/* 6c */      "JMP ($%04x)",
-/* 6d */      "ADC $%04x",
-/* 6e */      "ROR $%04x",
-/* 6f */      "illop_6f",
-/* 70 */      "BVS",
-/* 71 */      "ADC ($%02x,Y)",
-/* 72 */      "illop_72",
-/* 73 */      "illop_73",
-/* 74 */      "illop_74",
-/* 75 */      "ADC $%02x,X",
-/* 76 */      "ROR $%02x,X",
-/* 77 */      "illop_77",
-/* 78 */      "SEI",
-/* 79 */      "ADC $%04x,Y",
-/* 7a */      "illop_7a",
-/* 7b */      "illop_7b",
-/* 7c */      "illop_7c",
-/* 7d */      "ADC $%04x,X",
-/* 7e */      "ROR $%04x,X",
-/* 7f */      "illop_7f",
-/* 80 */      "illop_80",
-/* 81 */      "STA ($%02x,X)",
-/* 82 */      "illop_82",
-/* 83 */      "illop_83",
-/* 84 */      "STY $%02x",
-/* 85 */      "STA $%02x",
-/* 86 */      "STX $%02x",
-/* 87 */      "illop_87",
-/* 88 */      "DEY",
-/* 89 */      "illop_89",
-/* 8a */      "TXA",
-/* 8b */      "illop_8b",
-/* 8c */      "STY $%04x",
-/* 8d */      "STA $%04x",
-/* 8e */      "STX $%04x",
-/* 8f */      "illop_8f",
-/* 90 */      "BCC $%02x",
-/* 91 */      "STA ($%02x,Y)",
-/* 92 */      "illop_92",
-/* 93 */      "illop_93",
-/* 94 */      "STY $%02x,X",
-/* 95 */      "STA $%02x,X",
-/* 96 */      "STX $%02x,Y",
-/* 97 */      "illop_97",
-/* 98 */      "TYA",
-/* 99 */      "STA $%04x,Y",
-/* 9a */      "TXS",
-/* 9b */      "illop_9b",
-/* 9c */      "illop_9c",
-/* 9d */      "STA $%04x,X",
-/* 9e */      "illop_9e",
-/* 9f */      "illop_9f",
-/* a0 */      "LDY #$%02x",
-/* a1 */      "LDA ($%02x,X)",
-/* a2 */      "LDX #$%02x",
-/* a3 */      "illop_a3",
-/* a4 */      "LDY $%02x",
-/* a5 */      "LDA $%02x",
-/* a6 */      "LDX $%02x",
-/* a7 */      "illop_a7",
-/* a8 */      "TAY",
-/* a9 */      "LDA #$%02x",
-/* aa */      "TAX",
-/* ab */      "illop_ab",
-/* ac */      "LDY $%04x",
-/* ad */      "LDA $%04x",
-/* ae */      "LDX $%04x",
-/* af */      "illop_af",
-/* b0 */      "BCS $%02x",
-/* b1 */      "LDA ($%02x,Y)",
-/* b2 */      "illop_b2",
-/* b3 */      "illop_b3",
-/* b4 */      "LDY $%02x,X",
-/* b5 */      "LDA $%02x,X",
-/* b6 */      "LDX $%02x,Y",
-/* b7 */      "illop_b7",
-/* b8 */      "CLV",
-/* b9 */      "LDA $%04x,Y",
-/* ba */      "TSX",
-/* bb */      "illop_bb",
-/* bc */      "LDY $%04x,X",
-/* bd */      "LDA $%04x,X",
-/* be */      "LDX $%04x,Y",
-/* bf */      "illop_bf",
-/* c0 */      "CPY #$%02x",
-/* c1 */      "CMP ($%02x,X)",
-/* c2 */      "illop_c2",
-/* c3 */      "illop_c3",
-/* c4 */      "CPY $%02x",
-/* c5 */      "CMP $%02x",
-/* c6 */      "DEC $%02x",
-/* c7 */      "illop_c7",
-/* c8 */      "INY",
-/* c9 */      "CMP #$%02x",
-/* ca */      "DEX",
-/* cb */      "illop_cb",
-/* cc */      "CPY $%04x",
-/* cd */      "CMP $%04x",
-/* ce */      "DEC $%04x",
-/* cf */      "illop_cf",
-/* d0 */      "BNE $%02x",
-/* d1 */      "CMP ($%02x,Y)",
-/* d2 */      "illop_d2",
-/* d3 */      "illop_d3",
-/* d4 */      "illop_d4",
-/* d5 */      "CMP $%02x,X",
-/* d6 */      "DEC $%02x,X",
-/* d7 */      "illop_d7",
-/* d8 */      "CLD",
-/* d9 */      "CMP $%04x,Y",
-/* da */      "illop_da",
-/* db */      "illop_db",
-/* dc */      "illop_dc",
-/* dd */      "CMP $%04x,X",
-/* de */      "DEC $%04x,X",
-/* df */      "illop_df",
-/* e0 */      "CPX #$%02x",
-/* e1 */      "SBC ($%02x,X)",
-/* e2 */      "illop_e2",
-/* e3 */      "illop_e3",
-/* e4 */      "CPX $%02x",
-/* e5 */      "SBC $%02x",
-/* e6 */      "INC $%02x",
-/* e7 */      "illop_e7",
-/* e8 */      "INX",
-/* e9 */      "SBC #$%02x",
-/* ea */      "NOP",
-/* eb */      "illop_eb",
-/* ec */      "CPX $%04x",
-/* ed */      "SBC $%04x",
-/* ee */      "INC $%04x",
-/* ef */      "illop_ef",
-/* f0 */      "BEQ $%02x",
-/* f1 */      "SBC ($%02x,Y)",
-/* f2 */      "illop_f2",
-/* f3 */      "illop_f3",
-/* f4 */      "illop_f4",
-/* f5 */      "SBC $%02x,X",
-/* f6 */      "INC $%02x,X",
-/* f7 */      "illop_f7",
-/* f8 */      "SED",
-/* f9 */      "SBC $%04x,Y",
-/* fa */      "illop_fa",
-/* fb */      "illop_fb",
-/* fc */      "illop_fc",
-/* fd */      "SBC $%04x,X",
-/* fe */      "INC $%04x,X",
-/* ff */      "illop_ff",
-};
+#endif // EMUDORE_SRC_CPU6502_H
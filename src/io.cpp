@@ -33,6 +33,9 @@ DEFINE_bool(focus, false, "Whether joystick events require window focus");
 IO::IO(size_t cols, size_t rows, double refresh_rate)
     : cols_(cols),
     rows_(rows),
+    frame_cols_(cols),
+    frame_rows_(rows),
+    frame_resized_(false),
     scale_(FLAGS_scale),
     aspect_(FLAGS_aspect_ratio),
     refresh_rate_(refresh_rate)
@@ -372,7 +375,33 @@ void IO::screen_draw_border(int y, int color)
 }
 
 void IO::screen_blit(uint32_t* data) {
-    memcpy(frame_, data, rows_*cols_*sizeof(uint32_t));
+    screen_blit(data, cols_, rows_);
+}
+
+/**
+ * @brief blit a frame of a different size
+ *
+ * The frame is still drawn at the screen's size, so filters may hand over
+ * frames at higher resolutions.
+ */
+void IO::screen_blit(uint32_t* data, size_t cols, size_t rows) {
+    memcpy(screen_frame(cols, rows), data, rows*cols*sizeof(uint32_t));
+}
+
+/**
+ * @brief the frame uploaded on the next refresh
+ *
+ * Lets callers render directly into the frame rather than blit one.
+ */
+uint32_t* IO::screen_frame(size_t cols, size_t rows) {
+    if (cols != frame_cols_ || rows != frame_rows_) {
+        delete [] frame_;
+        frame_ = new uint32_t[cols * rows];
+        frame_cols_ = cols;
+        frame_rows_ = rows;
+        frame_resized_ = true;
+    }
+    return frame_;
 }
  
 /**
@@ -393,8 +422,16 @@ void IO::screen_refresh()
 
   glEnable(GL_TEXTURE_2D);
   glBindTexture(GL_TEXTURE_2D, nesimg_);
+  if (frame_resized_) {
+    GLfloat filter = frame_cols_ == cols_ ? GL_NEAREST : GL_LINEAR;
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, frame_cols_, frame_rows_, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, frame_);
+    frame_resized_ = false;
+  }
   glTexSubImage2D(GL_TEXTURE_2D, 0,
-                  0, 0, cols_, rows_,
+                  0, 0, frame_cols_, frame_rows_,
                   GL_RGBA, GL_UNSIGNED_BYTE, frame_);
 
   glBegin(GL_QUADS);
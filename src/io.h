@@ -57,6 +57,10 @@ class IO
     uint32_t *frame_;
     size_t cols_;
     size_t rows_;
+    /* size of frame_ and the texture, when blitted at another size */
+    size_t frame_cols_;
+    size_t frame_rows_;
+    bool frame_resized_;
     float scale_;
     float aspect_;
     double refresh_rate_;
@@ -111,6 +115,8 @@ class IO
     void screen_draw_rect(int x, int y, int n, int color);
     void screen_draw_border(int y, int color);
     void screen_blit(uint32_t* data);
+    void screen_blit(uint32_t* data, size_t cols, size_t rows);
+    uint32_t* screen_frame(size_t cols, size_t rows);
     void screen_refresh();
     void init_audio(int freq, int chan, int bufsz, SDL_AudioFormat fmt,
                     std::function<void(uint8_t*, int)> callback);
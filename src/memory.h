@@ -47,6 +47,8 @@ class Memory
     virtual uint16_t read_word_no_io(uint16_t) = 0;
     virtual void write_word(uint16_t addr, uint16_t v) = 0;
     virtual void write_word_no_io(uint16_t addr, uint16_t v) = 0;
+    /* hint from the cpu about the kind of the reads that follow */
+    void access_hint(uint8_t kind) {}
 };
 
 #endif
@@ -1,16 +1,38 @@
 #include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <gflags/gflags.h>
 #include <SDL2/SDL.h>
 #include "imgui.h"
 
 #include "src/nes/apu.h"
+#include "src/nes/mem.h"
 #include "src/nes/nes.h"
+#include "src/nes/recorder.h"
 
+DEFINE_bool(apu_thread, false, "Synthesize audio on a separate thread.");
 DEFINE_double(volume, 0.5, "Sound volume");
 
 static float pulse_table[32];
 static float other_table[204];
 
+// Interpolates between table entries, for levels averaged over a sample.
+static float mix(const float* table, int size, float x) {
+    if (x <= 0)
+        return table[0];
+    if (x >= size - 1)
+        return table[size - 1];
+    int i = int(x);
+    return table[i] + (table[i + 1] - table[i]) * (x - i);
+}
+
+// The first cycle of the next frame counter step after |cycle|.
+static uint64_t next_frame_event(uint64_t cycle) {
+    double step = std::floor(cycle / NES::frame_counter_rate) + 1;
+    return uint64_t(std::ceil(step * NES::frame_counter_rate));
+}
+
 static void init_tables() {
     static int once;
     int i;
@@ -26,30 +48,130 @@ static void init_tables() {
 }
 
 APU::APU(NES *nes)
+    : APU(nes, FLAGS_apu_thread ? SHADOW : SOLO) {}
+
+APU::APU(NES *nes, Role role)
     : nes_(nes),
+    role_(role),
     pulse_({1, 2}),
     dmc_(nes),
+    now_(0),
     cycle_(0),
+    frame_event_(next_frame_event(0)),
+    next_event_(frame_event_),
+    pulse_out_(NES::sample_rate),
+    tnd_out_(NES::sample_rate),
+    expansion_(nullptr),
+    ext_out_(NES::sample_rate),
     frame_period_(0),
     frame_value_(0),
     frame_irq_(0),
     volume_(FLAGS_volume),
+    speed_(1),
     data_{0, },
-    len_(0) {
+    len_(0),
+    capture_(false),
+    scope_cycle_(0),
+    synth_(nullptr),
+    quit_(false),
+    logged_(0),
+    replayed_(0),
+    replayed_cycle_(0) {
         mutex_ = SDL_CreateMutex();
         cond_ = SDL_CreateCond();
         init_tables();
+        if (role_ == SHADOW) {
+            // The shadow's fetches go to the log as well, and the synthesis
+            // side takes its bytes from there.
+            dmc_.set_reader([this, nes](uint16_t addr) {
+                nes->Stall(4);
+                uint8_t val = nes->memory()->ReadPcm(addr);
+                Log(cycle_, kDmcByte, val);
+                return val;
+            });
+            synth_ = new APU(nes, SYNTH);
+            synth_->dmc_.set_reader([this](uint16_t addr) {
+                uint8_t val = 0;
+                if (!synth_->dmc_bytes_.empty()) {
+                    val = synth_->dmc_bytes_.front();
+                    synth_->dmc_bytes_.pop_front();
+                }
+                return val;
+            });
+            thread_ = std::thread(&APU::SynthThread, this);
+        }
+}
+
+APU::~APU() {
+    if (synth_) {
+        quit_ = true;
+        thread_.join();
+        delete synth_;
+        delete expansion_;
+    }
+}
+
+void APU::Log(uint64_t cycle, uint16_t addr, uint8_t val) {
+    while(!log_.Push({cycle, addr, val}))
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    logged_++;
+}
+
+void APU::SynthThread() {
+    Record r;
+    while(!quit_) {
+        if (!log_.Pop(&r)) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            continue;
+        }
+        if (r.addr == kDmcByte) {
+            // Bytes are taken in order, so they can be handed over early.
+            synth_->dmc_bytes_.push_back(r.val);
+        } else if (r.addr == kSpeed) {
+            synth_->set_speed(r.val);
+        } else {
+            synth_->now_ = r.cycle;
+            if (r.addr == kClock)
+                synth_->Run(r.cycle);
+            else if (r.addr >= 0x4000 && r.addr <= 0x4017)
+                synth_->Write(r.addr, r.val);
+            else
+                synth_->WriteExpansion(r.addr, r.val);
+        }
+        replayed_cycle_.store(r.cycle, std::memory_order_release);
+        replayed_.fetch_add(1, std::memory_order_release);
+    }
+}
+
+void APU::Drain() {
+    if (!synth_)
+        return;
+    while(replayed_.load(std::memory_order_acquire) != logged_)
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
 }
 
 void APU::LoadState(proto::APU* state) {
+    if (synth_) {
+        Drain();
+        synth_->dmc_bytes_.clear();
+        synth_->LoadState(state);
+    }
     pulse_[0].LoadState(state->mutable_pulse(0));
     pulse_[1].LoadState(state->mutable_pulse(1));
     triangle_.LoadState(state->mutable_triangle());
     noise_.LoadState(state->mutable_noise());
     dmc_.LoadState(state->mutable_dmc());
+    Emit();
+    Schedule();
 }
 
 void APU::SaveState(proto::APU* state) {
+    // Only the synthesis side runs the timers and sequencers.
+    if (synth_) {
+        Drain();
+        synth_->SaveState(state);
+        return;
+    }
     state->clear_pulse();
     pulse_[0].SaveState(state->add_pulse());
     pulse_[1].SaveState(state->add_pulse());
@@ -58,14 +180,84 @@ void APU::SaveState(proto::APU* state) {
     dmc_.SaveState(state->mutable_dmc());
 }
 
-void APU::StepTimer() {
-    if (cycle_ % 2 == 0) {
-        pulse_[0].StepTimer();
-        pulse_[1].StepTimer();
-        noise_.StepTimer();
-        dmc_.StepTimer();
+void APU::Run(uint64_t to) {
+    while(cycle_ < to) {
+        uint64_t end = std::min(to, frame_event_);
+        if (role_ == SHADOW) {
+            dmc_.Run(cycle_, end, nullptr);
+            if (expansion_)
+                expansion_->Run(cycle_, end, nullptr);
+        } else {
+            pulse_[0].Run(cycle_, end, &pulse_out_);
+            pulse_[1].Run(cycle_, end, &pulse_out_);
+            triangle_.Run(cycle_, end, &tnd_out_);
+            noise_.Run(cycle_, end, &tnd_out_);
+            dmc_.Run(cycle_, end, &tnd_out_);
+            if (expansion_)
+                expansion_->Run(cycle_, end, &ext_out_);
+        }
+        cycle_ = end;
+        if (cycle_ == frame_event_) {
+            StepFrameCounter();
+            frame_event_ = next_frame_event(cycle_);
+            if (role_ == SHADOW) {
+                // Let the synthesis side run up to here, and don't get too
+                // far ahead of it.
+                Log(cycle_, kClock, 0);
+                while(cycle_ > replayed_cycle_.load(std::memory_order_acquire) +
+                               kMaxLag) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(200));
+                }
+            } else {
+                Emit();
+            }
+        }
+    }
+    if (role_ != SHADOW)
+        Flush();
+    if (capture_)
+        scope_cycle_.store(cycle_, std::memory_order_release);
+    Schedule();
+}
+
+void APU::Emit() {
+    pulse_[0].Emit(cycle_, &pulse_out_);
+    pulse_[1].Emit(cycle_, &pulse_out_);
+    triangle_.Emit(cycle_, &tnd_out_);
+    noise_.Emit(cycle_, &tnd_out_);
+    dmc_.Emit(cycle_, &tnd_out_);
+    if (expansion_)
+        expansion_->Emit(cycle_, &ext_out_);
+}
+
+void APU::Schedule() {
+    next_event_ = std::min(frame_event_, dmc_.NextFetch(cycle_));
+}
+
+void APU::Flush() {
+    int n = pulse_out_.Available(cycle_);
+    if (n <= 0)
+        return;
+    if (pulse_buf_.size() < size_t(n)) {
+        pulse_buf_.resize(n);
+        tnd_buf_.resize(n);
+        ext_buf_.resize(n);
+    }
+    pulse_out_.Read(pulse_buf_.data(), n);
+    tnd_out_.Read(tnd_buf_.data(), n);
+    ext_out_.Read(ext_buf_.data(), n);
+    for(int i=0; i<n; i++) {
+        float sample = volume_ * (mix(pulse_table, 32, pulse_buf_[i]) +
+                                  mix(other_table, 204, tnd_buf_[i]) +
+                                  ext_buf_[i]);
+        nes_->recorder()->Sample(sample);
+        if (speed_ == 1) {
+            Queue(sample);
+        } else if (speed_ > 1 && stretch_.Put(sample)) {
+            for(float out : stretch_.output())
+                Queue(out);
+        }
     }
-    triangle_.StepTimer();
 }
 
 void APU::StepEnvelope() {
@@ -88,7 +280,7 @@ void APU::StepLength() {
 }
 
 void APU::SignalIRQ() {
-    if (frame_irq_)
+    if (frame_irq_ && role_ != SYNTH)
         nes_->IRQ();
 }
 
@@ -114,19 +306,33 @@ void APU::StepFrameCounter() {
     }
 }
 
-float APU::Output() {
-    uint8_t p0 = pulse_[0].Output();
-    uint8_t p1 = pulse_[1].Output();
-    uint8_t t = triangle_.Output();
-    uint8_t n = noise_.Output();
-    uint8_t d = dmc_.Output();
-    return volume_* (pulse_table[p0+p1] + other_table[t*3 + n*2 + d]);
+void APU::Capture(bool on) {
+    if (on == capture_)
+        return;
+    capture_ = on;
+    scope_cycle_.store(cycle_, std::memory_order_release);
+    pulse_[0].set_scope(on ? &scope_[0] : nullptr, cycle_);
+    pulse_[1].set_scope(on ? &scope_[1] : nullptr, cycle_);
+    triangle_.set_scope(on ? &scope_[2] : nullptr, cycle_);
+    noise_.set_scope(on ? &scope_[3] : nullptr, cycle_);
+    dmc_.set_scope(on ? &scope_[4] : nullptr, cycle_);
 }
 
 void APU::DebugStuff() {
     static bool display_audio;
-
-    ImGui::SliderFloat("Volume", &volume_, 0.0f, 1.0f);
+    static bool trigger = true;
+    static float span_ms = 20.0f;
+    static const int kPoints = 512;
+    float wave[kPoints];
+
+    if (synth_)
+        return synth_->DebugStuff();
+
+    float volume = volume_;
+    if (ImGui::SliderFloat("Volume", &volume, 0.0f, 1.0f)) {
+        nes_->Live();
+        volume_ = volume;
+    }
     if (ImGui::BeginMenuBar()) {
         if (ImGui::BeginMenu("Audio")) {
             ImGui::MenuItem("Waveforms", nullptr, &display_audio);
@@ -136,47 +342,61 @@ void APU::DebugStuff() {
     }
 
     //if (ImGui::Button("Audio")) display_audio = !display_audio;
+    if (display_audio != capture_) {
+        nes_->Live();
+        Capture(display_audio);
+    }
     if (display_audio) {
         ImGui::Begin("Audio", &display_audio);
-        pulse_[0].DebugStuff();
-        pulse_[1].DebugStuff();
-        triangle_.DebugStuff();
-        noise_.DebugStuff();
-        dmc_.DebugStuff();
+        ImGui::Checkbox("Trigger", &trigger);
+        ImGui::SameLine();
+        ImGui::SliderFloat("Span (ms)", &span_ms, 1.0f, 200.0f);
+        uint64_t span = uint64_t(span_ms * NES::frequency / 1000);
+        uint64_t now = scope_cycle_.load(std::memory_order_acquire);
+        scope_[0].Trace(now, span, trigger, wave, kPoints);
+        pulse_[0].DebugStuff(wave, kPoints);
+        scope_[1].Trace(now, span, trigger, wave, kPoints);
+        pulse_[1].DebugStuff(wave, kPoints);
+        scope_[2].Trace(now, span, trigger, wave, kPoints);
+        triangle_.DebugStuff(wave, kPoints);
+        scope_[3].Trace(now, span, trigger, wave, kPoints);
+        noise_.DebugStuff(wave, kPoints);
+        scope_[4].Trace(now, span, trigger, wave, kPoints);
+        dmc_.DebugStuff(wave, kPoints);
         ImGui::End();
     }
 }
 
-void APU::Emulate() {
-    double c1 = double(cycle_);
-    double c2 = double(++cycle_);
-
-    StepTimer();
-
-    // Every 7457.38 clocks
-    int f1 = int(c1 / NES::frame_counter_rate);
-    int f2 = int(c2 / NES::frame_counter_rate);
-    if (f1 != f2)
-        StepFrameCounter();
+void APU::Queue(float sample) {
+    SDL_LockMutex(mutex_);
+    while(len_ == BUFFERLEN) {
+        SDL_CondWait(cond_, mutex_);
+    }
+    if (len_ < BUFFERLEN) {
+        data_[len_++] = sample;
+    } else {
+        fprintf(stderr, "Audio overrun\n");
+    }
+    SDL_UnlockMutex(mutex_);
+}
 
-    // Every 40.58 clocks
-    int s1 = int(c1 / NES::sample_rate);
-    int s2 = int(c2 / NES::sample_rate);
-    if (s1 != s2) {
-        SDL_LockMutex(mutex_);
-        while(len_ == BUFFERLEN) {
-            SDL_CondWait(cond_, mutex_);
-        }
-        if (len_ < BUFFERLEN) {
-            data_[len_++] = Output();
-        } else {
-            fprintf(stderr, "Audio overrun\n");
-        }
-        SDL_UnlockMutex(mutex_);
+void APU::set_speed(int speed) {
+    if (synth_) {
+        // The synthesis thread owns the time stretcher.
+        Log(cycle_, kSpeed, uint8_t(speed));
+        return;
+    }
+    speed_ = speed;
+    if (speed > 1) {
+        // Input left over from the last turbo run would play first.
+        stretch_.set_ratio(speed);
+        stretch_.Reset();
     }
 }
 
 void APU::PlayBuffer(uint8_t* stream, int bufsz) {
+    if (synth_)
+        return synth_->PlayBuffer(stream, bufsz);
     int n = bufsz / sizeof(float);
     if (len_ >= n) {
         SDL_LockMutex(mutex_);
@@ -193,6 +413,7 @@ void APU::PlayBuffer(uint8_t* stream, int bufsz) {
 }
 
 void APU::Write(uint16_t addr, uint8_t val) {
+    Run(now_);
     switch(addr) {
     case 0x4000: pulse_[0].set_control(val); break;
     case 0x4001: pulse_[0].set_sweep(val); break;
@@ -223,10 +444,48 @@ void APU::Write(uint16_t addr, uint8_t val) {
     default:
         ; // Nothing
     }
+    if (role_ == SHADOW)
+        Log(cycle_, addr, val);
+    else
+        Emit();
+    Schedule();
+}
+
+void APU::set_expansion(ExpansionAudio* audio) {
+    if (synth_) {
+        // The synthesis thread must be idle to pick up the new chip.
+        Drain();
+        synth_->set_expansion(audio);
+        Run(now_);
+        delete expansion_;
+        expansion_ = audio ? audio->NewShadow() : nullptr;
+        return;
+    }
+    Run(now_);
+    expansion_ = audio;
+    Emit();
+}
+
+void APU::WriteExpansion(uint16_t addr, uint8_t val) {
+    Run(now_);
+    if (role_ == SHADOW) {
+        Log(cycle_, addr, val);
+        if (expansion_)
+            expansion_->Write(addr, val);
+    } else if (expansion_) {
+        expansion_->Write(addr, val);
+        expansion_->Emit(cycle_, &ext_out_);
+    }
+}
+
+uint8_t APU::ReadExpansion(uint16_t addr) {
+    Run(now_);
+    return expansion_ ? expansion_->Read(addr) : 0;
 }
 
 uint8_t APU::Read(uint16_t addr) {
     uint8_t result = 0;
+    Run(now_);
     if (addr == 0x4015) {
         result |= (pulse_[0].length() > 0) << 0;
         result |= (pulse_[1].length() > 0) << 1;
@@ -2,42 +2,97 @@
 #define EMUDORE_SRC_NES_APU_H
 #include <cstdint>
 #include <atomic>
+#include <deque>
+#include <thread>
+#include <vector>
 #include <SDL2/SDL.h>
 
 #include "proto/apu.pb.h"
 #include "src/nes/apu_dmc.h"
+#include "src/nes/apu_expansion.h"
 #include "src/nes/apu_noise.h"
 #include "src/nes/apu_pulse.h"
+#include "src/nes/apu_scope.h"
+#include "src/nes/apu_synth.h"
 #include "src/nes/apu_triangle.h"
+#include "src/nes/spsc_queue.h"
+#include "src/nes/time_stretch.h"
 #include "src/nes/nes.h"
 
+// With --apu_thread, synthesis runs on a thread of its own.  The APU on
+// the emulation thread becomes a shadow: it keeps only what the CPU can
+// observe (length counters for $4015, the frame IRQ and DMC fetches) and
+// logs each register write and fetched DMC byte with its cycle.  A second
+// APU replays the log on the synthesis thread.
 class APU {
   public:
     APU(NES* nes);
+    ~APU();
 
     void Write(uint16_t addr, uint8_t val);
     uint8_t Read(uint16_t addr);
+    // Mixes a cartridge sound chip into the output.  Writes to its
+    // registers go through WriteExpansion so they take effect at the right
+    // cycle, on whichever thread synthesizes.
+    void set_expansion(ExpansionAudio* audio);
+    void WriteExpansion(uint16_t addr, uint8_t val);
+    uint8_t ReadExpansion(uint16_t addr);
 
     void PlayBuffer(uint8_t* stream, int len);
 
     void StepEnvelope();
     void StepLength();
     void StepSweep();
-    void StepTimer();
     void StepFrameCounter();
     void SignalIRQ();
-    float Output();
-    void Emulate();
+    // Advances the APU clock by |cycles| CPU cycles.  The channels are
+    // only run, in one batch each, when a frame counter step or DMC fetch
+    // comes due, or before a register access.
+    inline void Emulate(int cycles) {
+        now_ += cycles;
+        if (now_ >= next_event_)
+            Run(now_);
+    }
     void DebugStuff();
+    // At N times real time, output is time-stretched to real time so the
+    // audio device still paces the emulator.  0 drops all output without
+    // waiting for the audio device.
+    void set_speed(int speed);
+
+    // Waits for the synthesis thread to replay the whole log.
+    void Drain();
 
     void LoadState(proto::APU* state);
     void SaveState(proto::APU* state);
     static const int BUFFERLEN = 1024;
   private:
+    enum Role { SOLO, SHADOW, SYNTH };
+    struct Record {
+        uint64_t cycle;
+        uint16_t addr;
+        uint8_t val;
+    };
+    // Record addresses other than the APU registers.
+    static const uint16_t kClock = 0;
+    static const uint16_t kDmcByte = 1;
+    static const uint16_t kSpeed = 2;
+    // How far the emulator may run ahead of the synthesis thread.
+    static const uint64_t kMaxLag = 60000;
+
+    APU(NES* nes, Role role);
+    void Log(uint64_t cycle, uint16_t addr, uint8_t val);
+    void SynthThread();
     void set_frame_counter(uint8_t val);
     void set_control(uint8_t val);
+    void Run(uint64_t to);
+    void Emit();
+    void Schedule();
+    void Flush();
+    void Queue(float sample);
+    void Capture(bool on);
 
     NES* nes_;
+    Role role_;
     Pulse pulse_[2];
     Triangle triangle_;
     Noise noise_;
@@ -45,14 +100,49 @@ class APU {
     SDL_mutex *mutex_;
     SDL_cond *cond_;
 
+    // now_ is the CPU's clock; the channels have been run up to cycle_.
+    uint64_t now_;
     uint64_t cycle_;
+    uint64_t frame_event_;
+    uint64_t next_event_;
+    // Pulse levels, and triangle/noise/DMC levels, each go through their
+    // own nonlinear mixer.
+    Synth pulse_out_;
+    Synth tnd_out_;
+    std::vector<float> pulse_buf_;
+    std::vector<float> tnd_buf_;
+    // Expansion sound is linear, and added after the mixers.  The shadow
+    // owns its chip, a copy that only answers reads.
+    ExpansionAudio* expansion_;
+    Synth ext_out_;
+    std::vector<float> ext_buf_;
     uint8_t frame_period_;
     uint8_t frame_value_;;
     bool frame_irq_;
     float volume_;
+    int speed_;
+    TimeStretch stretch_;
 
     float data_[BUFFERLEN];
     std::atomic<int> len_;
+
+    // Waveform capture for the oscilloscope, only while it is shown.  The
+    // scope is drawn without suspending the emulator, so the cycle it ends
+    // at is published separately.
+    bool capture_;
+    Scope scope_[5];
+    std::atomic<uint64_t> scope_cycle_;
+
+    // The synthesis side, owned by the shadow.
+    APU* synth_;
+    std::thread thread_;
+    std::atomic<bool> quit_;
+    SpscQueue<Record, 4096> log_;
+    uint64_t logged_;
+    std::atomic<uint64_t> replayed_;
+    std::atomic<uint64_t> replayed_cycle_;
+    // DMC bytes waiting for the synthesis side's DMC.
+    std::deque<uint8_t> dmc_bytes_;
 };
 
 #endif // EMUDORE_SRC_NES_APU_H
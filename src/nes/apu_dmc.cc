@@ -9,13 +9,18 @@ static uint8_t dmc_table[16] = {
 
 DMC::DMC(NES* nes) :
     nes_(nes),
+    reader_([nes](uint16_t addr) {
+        nes->Stall(4);
+        return nes->memory()->ReadPcm(addr);
+    }),
     enabled_(0),
     value_(0),
+    level_(0),
     sample_address_(0), sample_length_(0),
     current_address_(0), current_length_(0),
     shift_register_(0), bit_count_(0), tick_value_(0), tick_period_(0),
     loop_(0), irq_(0),
-    dbgp_(0) {}
+    scope_(nullptr) {}
 
 void DMC::SaveState(proto::APUDMC *state) {
     SAVE(enabled,
@@ -35,15 +40,25 @@ void DMC::LoadState(proto::APUDMC *state) {
          loop, irq);
 }
 
-uint8_t DMC::Output() {
-    dbgbuf_[dbgp_] = value_;
-    dbgp_ = (dbgp_ + 1) % DBGBUFSZ;
-    return value_;
+void DMC::Emit(uint64_t cycle, Synth* out) {
+    if (value_ == level_)
+        return;
+    if (out)
+        out->Add(cycle, float(value_) - float(level_));
+    level_ = value_;
+    if (scope_)
+        scope_->Add(cycle, value_);
+}
+
+void DMC::set_scope(Scope* scope, uint64_t cycle) {
+    scope_ = scope;
+    if (scope_)
+        scope_->Add(cycle, level_);
 }
 
-void DMC::DebugStuff() {
+void DMC::DebugStuff(const float* wave, int n) {
     ImGui::BeginGroup();
-    ImGui::PlotLines("", dbgbuf_, DBGBUFSZ, dbgp_, "DMC", 0.0f, 127.0f, ImVec2(0,80));
+    ImGui::PlotLines("", wave, n, 0, "DMC", 0.0f, 127.0f, ImVec2(0,80));
     ImGui::SameLine();
     ImGui::BeginGroup();
     ImGui::Text("Enabled %s", enabled_ ? "true" : "false");
@@ -57,8 +72,7 @@ void DMC::DebugStuff() {
 
 void DMC::StepReader() {
     if (current_length_ > 0 && bit_count_ == 0) {
-        nes_->Stall(4);
-        shift_register_ = nes_->memory()->Read(current_address_);
+        shift_register_ = reader_(current_address_);
         bit_count_ = 8;
         current_address_++;
         if (current_address_ == 0)
@@ -82,18 +96,39 @@ void DMC::StepShifter() {
     bit_count_--;
 }
 
-void DMC::StepTimer() {
+void DMC::Run(uint64_t from, uint64_t to, Synth* out) {
     if (!enabled_)
         return;
-    StepReader();
-    if (tick_value_ == 0) {
+    // Clocked on even cycles.  Each clock first fetches a byte if the
+    // shifter is empty, then runs the timer, which shifts out a bit when it
+    // passes zero.  The shifter only empties on a timer step, so the fetch
+    // only needs checking at the first clock and the one after each step.
+    uint64_t t = (from & ~1ull) + 2;
+    while(t <= to) {
+        StepReader();
+        uint64_t shift = t + 2 * uint64_t(tick_value_);
+        if (shift > to) {
+            tick_value_ -= ((to & ~1ull) - t) / 2 + 1;
+            break;
+        }
         tick_value_ = tick_period_;
         StepShifter();
-    } else {
-        tick_value_--;
+        Emit(shift, out);
+        t = shift + 2;
     }
 }
 
+uint64_t DMC::NextFetch(uint64_t now) const {
+    if (!enabled_ || current_length_ == 0)
+        return UINT64_MAX;
+    uint64_t t = (now & ~1ull) + 2;
+    if (bit_count_ == 0)
+        return t;
+    // The clock after the step that shifts out the last bit.
+    return t + 2 * uint64_t(tick_value_) +
+           2 * (uint64_t(tick_period_) + 1) * (bit_count_ - 1) + 2;
+}
+
 void DMC::set_enabled(bool val) {
     enabled_ = val;
     if (!enabled_) {
@@ -1,17 +1,27 @@
 #ifndef EMUDORE_SRC_NES_APU_DMC_H
 #define EMUDORE_SRC_NES_APU_DMC_H
 #include <cstdint>
+#include <functional>
 #include "src/nes/nes.h"
 #include "proto/apu.pb.h"
+#include "src/nes/apu_scope.h"
+#include "src/nes/apu_synth.h"
 
 class DMC {
   public:
     DMC(NES* nes);
-    
-    uint8_t Output();
+
+    // Runs the timer over the cycles after |from| up to |to|, adding each
+    // change in output to |out|.  Sample bytes are fetched as they are
+    // needed.
+    void Run(uint64_t from, uint64_t to, Synth* out);
+    // Adds a change in output from a register write.  |out| may be null
+    // when only the fetches matter.
+    void Emit(uint64_t cycle, Synth* out);
+    // The cycle of the next sample fetch after |now|, or UINT64_MAX.
+    uint64_t NextFetch(uint64_t now) const;
     void StepReader();
     void StepShifter();
-    void StepTimer();
 
     void set_enabled(bool val);
     void set_control(uint8_t val);
@@ -19,15 +29,23 @@ class DMC {
     void set_address(uint8_t val);
     void set_length(uint8_t val);
     inline uint16_t length() const { return current_length_; }
+    // Where sample bytes come from.  By default they are read from CPU
+    // memory, stalling the CPU.
+    inline void set_reader(std::function<uint8_t(uint16_t)> reader) {
+        reader_ = reader;
+    }
     void restart();
-    void DebugStuff();
+    // Level changes are also added to |scope| while it is set.
+    void set_scope(Scope* scope, uint64_t cycle);
+    void DebugStuff(const float* wave, int n);
     void LoadState(proto::APUDMC* state);
     void SaveState(proto::APUDMC* state);
   private:
-    uint8_t InternalOutput();
     NES* nes_;
+    std::function<uint8_t(uint16_t)> reader_;
     bool enabled_;
     uint8_t value_;
+    uint8_t level_;
 
     uint16_t sample_address_;
     uint16_t sample_length_;
@@ -44,9 +62,7 @@ class DMC {
     struct {
         uint8_t control, value, address, length;
     } reg_;
-    const static int DBGBUFSZ = 1024;
-    float dbgbuf_[DBGBUFSZ];
-    int dbgp_;
+    Scope* scope_;
 };
 
 #endif // EMUDORE_SRC_NES_APU_DMC_H
@@ -0,0 +1,33 @@
+#ifndef EMUDORE_SRC_NES_APU_EXPANSION_H
+#define EMUDORE_SRC_NES_APU_EXPANSION_H
+#include <cstdint>
+
+#include "src/nes/apu_synth.h"
+
+// A sound chip on the cartridge, mixed with the APU's own channels.
+//
+// A mapper that has one hands it to APU::set_expansion and sends writes to
+// its registers through APU::WriteExpansion.  The APU runs the chip in the
+// same batches as its own channels, so it costs one call per batch rather
+// than one per cycle, and with --apu_thread the chip only ever runs on the
+// synthesis thread.  Levels go to the Synth in output units, after the
+// 2A03's nonlinear mixer: a 2A03 pulse at full volume is about 0.15.
+class ExpansionAudio {
+  public:
+    virtual ~ExpansionAudio() {}
+    virtual void Write(uint16_t addr, uint8_t val) = 0;
+    // Runs the chip over the cycles after |from| up to |to|, adding each
+    // change in output to |out|.
+    virtual void Run(uint64_t from, uint64_t to, Synth* out) = 0;
+    // Adds a change in output from a register write.
+    virtual void Emit(uint64_t cycle, Synth* out) = 0;
+    // Registers the CPU can read, such as length counter status.
+    virtual uint8_t Read(uint16_t addr) { return 0; }
+    // With --apu_thread, a new copy of the chip that answers Read on the
+    // emulation thread.  It sees the same writes, and Run is called with no
+    // Synth, so it need only keep what Read reports.  nullptr if the chip
+    // has no readable registers.
+    virtual ExpansionAudio* NewShadow() { return nullptr; }
+};
+
+#endif // EMUDORE_SRC_NES_APU_EXPANSION_H
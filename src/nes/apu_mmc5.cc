@@ -0,0 +1,81 @@
+#include "src/nes/apu_mmc5.h"
+
+// One step of pulse volume, the same as a 2A03 pulse's.  The PCM level at
+// full scale is about as loud as the DMC at full scale.
+static const float kPulseGain = 95.52f / (8128.0f / 15 + 100) / 15;
+static const float kPcmGain = 159.79f / (22638.0f / 127 + 100) / 255;
+// CPU cycles per 240 Hz frame counter step.
+static const uint32_t kFrame = 7457;
+
+Mmc5Audio::Mmc5Audio()
+    : pulse_{2, 2},
+    pcm_read_(false),
+    pcm_(0),
+    pcm_level_(0),
+    step_(kFrame) {
+    pulse_[0].set_gain(kPulseGain);
+    pulse_[1].set_gain(kPulseGain);
+}
+
+void Mmc5Audio::Write(uint16_t addr, uint8_t val) {
+    if (addr < 0x5008) {
+        Pulse* p = &pulse_[(addr >> 2) & 1];
+        switch(addr & 3) {
+        case 0: p->set_control(val); break;
+        case 2: p->set_timer_low(val); break;
+        case 3: p->set_timer_high(val); break;
+        default: ;
+        }
+    } else if (addr == 0x5010) {
+        pcm_read_ = val & 1;
+    } else if (addr == 0x5011) {
+        // Writes of zero are ignored.  Read mode, which samples the CPU's
+        // reads of $8000-$BFFF, isn't supported.
+        if (!pcm_read_ && val)
+            pcm_ = val;
+    } else if (addr == 0x5015) {
+        pulse_[0].set_enabled(val & 1);
+        pulse_[1].set_enabled(val & 2);
+    }
+}
+
+uint8_t Mmc5Audio::Read(uint16_t addr) {
+    if (addr != 0x5015)
+        return 0;
+    return (pulse_[0].length() ? 1 : 0) | (pulse_[1].length() ? 2 : 0);
+}
+
+ExpansionAudio* Mmc5Audio::NewShadow() {
+    return new Mmc5Audio();
+}
+
+void Mmc5Audio::Run(uint64_t from, uint64_t to, Synth* out) {
+    // Without a Synth, only the length counters matter.
+    while(from + step_ <= to) {
+        uint64_t at = from + step_;
+        for(Pulse& p : pulse_) {
+            if (out)
+                p.Run(from, at, out);
+            p.StepEnvelope();
+            p.StepLength();
+            if (out)
+                p.Emit(at, out);
+        }
+        from = at;
+        step_ = kFrame;
+    }
+    if (out) {
+        for(Pulse& p : pulse_)
+            p.Run(from, to, out);
+    }
+    step_ -= uint32_t(to - from);
+}
+
+void Mmc5Audio::Emit(uint64_t cycle, Synth* out) {
+    pulse_[0].Emit(cycle, out);
+    pulse_[1].Emit(cycle, out);
+    if (pcm_ != pcm_level_) {
+        out->Add(cycle, (float(pcm_) - float(pcm_level_)) * kPcmGain);
+        pcm_level_ = pcm_;
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef EMUDORE_SRC_NES_APU_MMC5_H
+#define EMUDORE_SRC_NES_APU_MMC5_H
+#include <cstdint>
+
+#include "src/nes/apu_expansion.h"
+#include "src/nes/apu_pulse.h"
+
+// Nintendo MMC5 sound: two pulses like the 2A03's, without sweep units,
+// and an 8-bit PCM level.  Their envelopes and lengths are clocked at a
+// fixed 240 Hz.  The registers are at $5000-$5015.
+class Mmc5Audio: public ExpansionAudio {
+  public:
+    Mmc5Audio();
+    void Write(uint16_t addr, uint8_t val) override;
+    void Run(uint64_t from, uint64_t to, Synth* out) override;
+    void Emit(uint64_t cycle, Synth* out) override;
+    // $5015 reports which pulses have length left.
+    uint8_t Read(uint16_t addr) override;
+    ExpansionAudio* NewShadow() override;
+  private:
+    Pulse pulse_[2];
+    bool pcm_read_;
+    uint8_t pcm_;
+    uint8_t pcm_level_;
+    // Cycles until the next envelope and length clock.
+    uint32_t step_;
+};
+
+#endif // EMUDORE_SRC_NES_APU_MMC5_H
@@ -14,6 +14,7 @@ static uint16_t noise_table[] = {
 Noise::Noise()
     : enabled_(false),
     mode_(false),
+    level_(0),
     shift_register_(1),
     length_enabled_(false),
     length_value_(0),
@@ -21,7 +22,7 @@ Noise::Noise()
     envelope_enable_(false), envelope_start_(false), envelope_loop_(false),
     envelope_period_(0), envelope_value_(0), envelope_volume_(0),
     constant_volume_(0),
-    dbgp_(0) {}
+    scope_(nullptr) {}
 
 void Noise::SaveState(proto::APUNoise* state) {
     SAVE(enabled,
@@ -55,16 +56,25 @@ uint8_t Noise::InternalOutput() {
     return constant_volume_;
 }
 
-uint8_t Noise::Output() {
+void Noise::Emit(uint64_t cycle, Synth* out) {
     uint8_t val = InternalOutput();
-    dbgbuf_[dbgp_] = val;
-    dbgp_ = (dbgp_ + 1) % DBGBUFSZ;
-    return val;
+    if (val == level_)
+        return;
+    out->Add(cycle, 2.0f * (float(val) - float(level_)));
+    level_ = val;
+    if (scope_)
+        scope_->Add(cycle, val);
 }
 
-void Noise::DebugStuff() {
+void Noise::set_scope(Scope* scope, uint64_t cycle) {
+    scope_ = scope;
+    if (scope_)
+        scope_->Add(cycle, level_);
+}
+
+void Noise::DebugStuff(const float* wave, int n) {
     ImGui::BeginGroup();
-    ImGui::PlotLines("", dbgbuf_, DBGBUFSZ, dbgp_, "Noise", 0.0f, 15.0f, ImVec2(0,80));
+    ImGui::PlotLines("", wave, n, 0, "Noise", 0.0f, 15.0f, ImVec2(0,80));
     ImGui::SameLine();
     ImGui::BeginGroup();
     ImGui::Text("Enabled %s", enabled_ ? "true" : "false");
@@ -75,16 +85,23 @@ void Noise::DebugStuff() {
     ImGui::EndGroup();
 }
 
-void Noise::StepTimer() {
-    if (timer_value_ == 0) {
-        timer_value_ = timer_period_;
-        unsigned shift = mode_ ? 6 : 1;
+void Noise::Run(uint64_t from, uint64_t to, Synth* out) {
+    // Like the pulse timer, clocked on even cycles.  The shift register
+    // has to be stepped even while silent, to be in the right state when
+    // the channel is heard again.
+    uint64_t step = 2 * (uint64_t(timer_period_) + 1);
+    uint64_t t = (from & ~1ull) + 2 + 2 * uint64_t(timer_value_);
+    unsigned shift = mode_ ? 6 : 1;
+    bool silent = !enabled_ || length_value_ == 0 ||
+                  (envelope_enable_ ? envelope_volume_ : constant_volume_) == 0;
+    for(; t <= to; t += step) {
         uint16_t b1 = shift_register_ & 1;
         uint16_t b2 = (shift_register_ >> shift) & 1;
         shift_register_ = (shift_register_ >> 1) | ((b1 ^ b2) << 14);
-    } else {
-        timer_value_--;
+        if (!silent)
+            Emit(t, out);
     }
+    timer_value_ = (t - (to & ~1ull) - 2) / 2;
 }
 
 void Noise::StepEnvelope() {
@@ -2,12 +2,17 @@
 #define EMUDORE_SRC_NES_APU_NOISE_H
 #include <cstdint>
 #include "proto/apu.pb.h"
+#include "src/nes/apu_scope.h"
+#include "src/nes/apu_synth.h"
 
 class Noise {
   public:
     Noise();
-    uint8_t Output();
-    void StepTimer();
+    // Runs the timer over the cycles after |from| up to |to|, adding each
+    // change in output to |out|.
+    void Run(uint64_t from, uint64_t to, Synth* out);
+    // Adds a change in output from a register write or frame counter step.
+    void Emit(uint64_t cycle, Synth* out);
     void StepEnvelope();
     void StepLength();
 
@@ -16,13 +21,16 @@ class Noise {
     void set_period(uint8_t val);
     void set_length(uint8_t val);
     inline uint16_t length() const { return length_value_; }
-    void DebugStuff();
+    // Level changes are also added to |scope| while it is set.
+    void set_scope(Scope* scope, uint64_t cycle);
+    void DebugStuff(const float* wave, int n);
     void SaveState(proto::APUNoise *state);
     void LoadState(proto::APUNoise *state);
   private:
     uint8_t InternalOutput();
     bool enabled_;
     bool mode_;
+    uint8_t level_;
 
     uint16_t shift_register_;
 
@@ -44,9 +52,7 @@ class Noise {
     struct {
         uint8_t control, period, length;
     } reg_;
-    const static int DBGBUFSZ = 1024;
-    float dbgbuf_[DBGBUFSZ];
-    int dbgp_;
+    Scope* scope_;
 };
 
 #endif // EMUDORE_SRC_NES_APU_NOISE_H
@@ -24,6 +24,8 @@ static uint8_t length_table[32] = {
 Pulse::Pulse(uint8_t channel)
     : enabled_(false),
     channel_(channel),
+    level_(0),
+    gain_(1.0f),
     length_enabled_(false), length_value_(0),
     timer_period_(0), timer_value_(0),
     duty_mode_(0), duty_value_(0),
@@ -32,7 +34,7 @@ Pulse::Pulse(uint8_t channel)
     envelope_enable_(false), envelope_start_(false), envelope_loop_(false),
     envelope_period_(0), envelope_value_(0), envelope_volume_(0),
     constant_volume_(0),
-    dbgp_(0) {}
+    scope_(nullptr) {}
 
 void Pulse::SaveState(proto::APUPulse* state) {
     SAVE(enabled,
@@ -90,16 +92,25 @@ uint8_t Pulse::InternalOutput() {
     return constant_volume_;
 }
 
-uint8_t Pulse::Output() {
+void Pulse::Emit(uint64_t cycle, Synth* out) {
     uint8_t val = InternalOutput();
-    dbgbuf_[dbgp_] = val;
-    dbgp_ = (dbgp_ + 1) % DBGBUFSZ;
-    return val;
+    if (val == level_)
+        return;
+    out->Add(cycle, (float(val) - float(level_)) * gain_);
+    level_ = val;
+    if (scope_)
+        scope_->Add(cycle, val);
 }
 
-void Pulse::DebugStuff() {
+void Pulse::set_scope(Scope* scope, uint64_t cycle) {
+    scope_ = scope;
+    if (scope_)
+        scope_->Add(cycle, level_);
+}
+
+void Pulse::DebugStuff(const float* wave, int n) {
     ImGui::BeginGroup();
-    ImGui::PlotLines("", dbgbuf_, DBGBUFSZ, dbgp_, "Pulse", 0.0f, 15.0f, ImVec2(0,80));
+    ImGui::PlotLines("", wave, n, 0, "Pulse", 0.0f, 15.0f, ImVec2(0,80));
     ImGui::SameLine();
     ImGui::BeginGroup();
     ImGui::Text("Enabled %s", enabled_ ? "true" : "false");
@@ -121,13 +132,27 @@ void Pulse::Sweep() {
     }
 }
 
-void Pulse::StepTimer() {
-    if (timer_value_ == 0) {
-        timer_value_ = timer_period_;
-        duty_value_ = (duty_value_ + 1) % 8;
+void Pulse::Run(uint64_t from, uint64_t to, Synth* out) {
+    // The timer is clocked on even cycles and steps the sequencer when it
+    // passes zero, then reloads.
+    uint64_t step = 2 * (uint64_t(timer_period_) + 1);
+    uint64_t t = (from & ~1ull) + 2 + 2 * uint64_t(timer_value_);
+    uint8_t volume = envelope_enable_ ? envelope_volume_ : constant_volume_;
+    if (volume == 0 || !enabled_ || length_value_ == 0 ||
+        timer_period_ < 8 || timer_period_ > 0x7ff) {
+        // Silent whatever the sequencer does, so skip straight to the end.
+        if (t <= to) {
+            uint64_t n = (to - t) / step + 1;
+            duty_value_ = (duty_value_ + n) % 8;
+            t += n * step;
+        }
     } else {
-        timer_value_--;
+        for(; t <= to; t += step) {
+            duty_value_ = (duty_value_ + 1) % 8;
+            Emit(t, out);
+        }
     }
+    timer_value_ = (t - (to & ~1ull) - 2) / 2;
 }
 
 void Pulse::StepEnvelope() {
@@ -2,13 +2,18 @@
 #define EMUDORE_SRC_NES_APU_PULSE_H
 #include <cstdint>
 #include "proto/apu.pb.h"
+#include "src/nes/apu_scope.h"
+#include "src/nes/apu_synth.h"
 
 class Pulse {
   public:
     Pulse(uint8_t channel);
-    uint8_t Output();
+    // Runs the timer over the cycles after |from| up to |to|, adding each
+    // change in output to |out|.
+    void Run(uint64_t from, uint64_t to, Synth* out);
+    // Adds a change in output from a register write or frame counter step.
+    void Emit(uint64_t cycle, Synth* out);
     void Sweep();
-    void StepTimer();
     void StepEnvelope();
     void StepSweep();
     void StepLength();
@@ -19,13 +24,19 @@ class Pulse {
     void set_timer_low(uint8_t val);
     void set_timer_high(uint8_t val);
     inline uint16_t length() const { return length_value_; }
-    void DebugStuff();
+    // Scales the changes Emit adds, which are otherwise in volume steps.
+    inline void set_gain(float gain) { gain_ = gain; }
+    // Level changes are also added to |scope| while it is set.
+    void set_scope(Scope* scope, uint64_t cycle);
+    void DebugStuff(const float* wave, int n);
     void LoadState(proto::APUPulse* state);
     void SaveState(proto::APUPulse* state);
   private:
     uint8_t InternalOutput();
     bool enabled_;
     uint8_t channel_;
+    uint8_t level_;
+    float gain_;
 
     bool length_enabled_;
     uint8_t length_value_;
@@ -55,9 +66,7 @@ class Pulse {
     struct {
         uint8_t control, sweep, tlo, thi;
     } reg_;
-    const static int DBGBUFSZ = 1024;
-    float dbgbuf_[DBGBUFSZ];
-    int dbgp_;
+    Scope* scope_;
 };
 
 #endif // EMUDORE_SRC_NES_APU_PULSE_H
@@ -0,0 +1,43 @@
+#include <cstddef>
+#include <vector>
+
+#include "src/nes/apu_scope.h"
+
+void Scope::Trace(uint64_t now, uint64_t span, bool trigger,
+                  float* out, int n) const {
+    uint32_t head = head_.load(std::memory_order_acquire);
+    uint32_t count = head < kSize ? head : kSize;
+    std::vector<uint64_t> points(count);
+    for(uint32_t i=0; i<count; i++) {
+        points[i] = ring_[(head - count + i) % kSize].load(
+                std::memory_order_relaxed);
+    }
+    // Entries the writer got to while we were copying may be newer than
+    // the rest; skip that many from the oldest end.
+    uint32_t lost = head_.load(std::memory_order_acquire) - head;
+    size_t first = lost < count ? lost : count;
+
+    uint64_t start = now > span ? now - span : 0;
+    if (trigger) {
+        for(size_t i=points.size(); i-- > first + 1;) {
+            uint64_t cycle = points[i] >> 8;
+            if (cycle + span <= now &&
+                (points[i] & 0xFF) > (points[i - 1] & 0xFF)) {
+                start = cycle;
+                break;
+            }
+        }
+    }
+
+    // Walk the changes alongside the sample times.
+    size_t p = first;
+    float level = 0;
+    for(int i=0; i<n; i++) {
+        uint64_t t = start + span * i / n;
+        while(p < points.size() && (points[p] >> 8) <= t) {
+            level = float(points[p] & 0xFF);
+            p++;
+        }
+        out[i] = level;
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef EMUDORE_SRC_NES_APU_SCOPE_H
+#define EMUDORE_SRC_NES_APU_SCOPE_H
+#include <atomic>
+#include <cstdint>
+
+// Keeps a channel's recent level changes for the oscilloscope.
+//
+// The thread running the channel adds entries; the UI reads them without
+// locking.  Each entry packs the cycle and level into one atomic word, and
+// a reader drops whatever the writer may have overwritten while it copied.
+class Scope {
+  public:
+    Scope() : head_(0), ring_{} {}
+
+    inline void Add(uint64_t cycle, uint8_t level) {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        ring_[head % kSize].store(cycle << 8 | level,
+                                  std::memory_order_relaxed);
+        head_.store(head + 1, std::memory_order_release);
+    }
+
+    // Fills |out| with the level at |n| evenly spaced cycles over the |span|
+    // cycles ending at |now|.  With |trigger|, the window starts at the
+    // last rising edge that leaves room for a full window, so periodic
+    // waveforms hold still from one refresh to the next.
+    void Trace(uint64_t now, uint64_t span, bool trigger,
+               float* out, int n) const;
+
+  private:
+    static const uint32_t kSize = 16384;
+    std::atomic<uint32_t> head_;
+    std::atomic<uint64_t> ring_[kSize];
+};
+
+#endif // EMUDORE_SRC_NES_APU_SCOPE_H
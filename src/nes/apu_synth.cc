@@ -0,0 +1,15 @@
+#include <algorithm>
+
+#include "src/nes/apu_synth.h"
+
+void Synth::Read(float* out, int n) {
+    if (size_t(n) + 2 > buf_.size())
+        buf_.resize(n + 2, 0.0f);
+    for(int i=0; i<n; i++) {
+        level_ += buf_[i];
+        out[i] = level_;
+    }
+    std::copy(buf_.begin() + n, buf_.end(), buf_.begin());
+    std::fill(buf_.end() - n, buf_.end(), 0.0f);
+    sample_ += n;
+}
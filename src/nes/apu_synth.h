@@ -0,0 +1,45 @@
+#ifndef EMUDORE_SRC_NES_APU_SYNTH_H
+#define EMUDORE_SRC_NES_APU_SYNTH_H
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Builds output samples from changes in a channel's level.
+//
+// Channels add the change in their level at the CPU cycle it happens, so
+// the cost follows the number of transitions, not the number of cycles.
+// Each output sample is the average level over its period: a change part
+// way through a sample counts for the rest of that sample, and for every
+// sample after it once the changes are summed up in Read.
+class Synth {
+  public:
+    Synth(double cycles_per_sample)
+      : rate_(cycles_per_sample), sample_(0), level_(0), buf_(1024, 0.0f) {}
+
+    inline void Add(uint64_t cycle, float delta) {
+        double pos = cycle / rate_ - double(sample_);
+        size_t i = size_t(pos);
+        float frac = float(pos - double(i));
+        if (i + 2 > buf_.size())
+            buf_.resize(i + 2, 0.0f);
+        buf_[i] += delta * (1.0f - frac);
+        buf_[i + 1] += delta * frac;
+    }
+
+    // The number of samples whose period ends by |cycle|.
+    inline int Available(uint64_t cycle) const {
+        return int(uint64_t(cycle / rate_) - sample_);
+    }
+
+    // Removes the next |n| samples, writing their levels to |out|.
+    void Read(float* out, int n);
+
+  private:
+    double rate_;
+    // The sample buf_[0] belongs to.
+    uint64_t sample_;
+    float level_;
+    std::vector<float> buf_;
+};
+
+#endif // EMUDORE_SRC_NES_APU_SYNTH_H
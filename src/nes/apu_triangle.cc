@@ -14,13 +14,14 @@ static uint8_t triangle_table[32] = {
 
 Triangle::Triangle()
     : enabled_(false),
+    level_(0),
     length_enabled_(false),
     length_value_(0),
     timer_period_(0), timer_value_(0),
     duty_value_(0),
     counter_reload_(false),
     counter_period_(0), counter_value_(0),
-    dbgp_(0) {}
+    scope_(nullptr) {}
 
 void Triangle::SaveState(proto::APUTriangle *state) {
     SAVE(enabled,
@@ -47,16 +48,26 @@ uint8_t Triangle::InternalOutput() {
     return triangle_table[duty_value_];
 }
 
-uint8_t Triangle::Output() {
+void Triangle::Emit(uint64_t cycle, Synth* out) {
     uint8_t val = InternalOutput();
-    dbgbuf_[dbgp_] = val;
-    dbgp_ = (dbgp_ + 1) % DBGBUFSZ;
-    return val;
+    if (val == level_)
+        return;
+    // The triangle counts three times as much as noise or DMC in the mix.
+    out->Add(cycle, 3.0f * (float(val) - float(level_)));
+    level_ = val;
+    if (scope_)
+        scope_->Add(cycle, val);
 }
 
-void Triangle::DebugStuff() {
+void Triangle::set_scope(Scope* scope, uint64_t cycle) {
+    scope_ = scope;
+    if (scope_)
+        scope_->Add(cycle, level_);
+}
+
+void Triangle::DebugStuff(const float* wave, int n) {
     ImGui::BeginGroup();
-    ImGui::PlotLines("", dbgbuf_, DBGBUFSZ, dbgp_, "Triangle", 0.0f, 15.0f, ImVec2(0,80));
+    ImGui::PlotLines("", wave, n, 0, "Triangle", 0.0f, 15.0f, ImVec2(0,80));
     ImGui::SameLine();
     ImGui::BeginGroup();
     ImGui::Text("Enabled %s", enabled_ ? "true" : "false");
@@ -66,14 +77,22 @@ void Triangle::DebugStuff() {
     ImGui::EndGroup();
 }
 
-void Triangle::StepTimer() {
-    if (timer_value_ == 0) {
-        timer_value_ = timer_period_;
-        if (length_value_ > 0 && counter_value_ > 0)
-            duty_value_ = (duty_value_ + 1) % 32;
+void Triangle::Run(uint64_t from, uint64_t to, Synth* out) {
+    // The timer is clocked every cycle.  The sequencer only moves while
+    // both counters are running.  Periods below 2 are ultrasonic; the
+    // sequencer holds still rather than producing a transition per cycle.
+    uint64_t step = uint64_t(timer_period_) + 1;
+    uint64_t t = from + 1 + timer_value_;
+    if (length_value_ == 0 || counter_value_ == 0 || timer_period_ < 2) {
+        if (t <= to)
+            t += ((to - t) / step + 1) * step;
     } else {
-        timer_value_--;
+        for(; t <= to; t += step) {
+            duty_value_ = (duty_value_ + 1) % 32;
+            Emit(t, out);
+        }
     }
+    timer_value_ = t - to - 1;
 }
 
 void Triangle::StepLength() {
@@ -2,13 +2,18 @@
 #define EMUDORE_SRC_NES_APU_TRIANGLE_H
 #include <cstdint>
 #include "proto/apu.pb.h"
+#include "src/nes/apu_scope.h"
+#include "src/nes/apu_synth.h"
 
 class Triangle {
   public:
     Triangle();
 
-    uint8_t Output();
-    void StepTimer();
+    // Runs the timer over the cycles after |from| up to |to|, adding each
+    // change in output to |out|.
+    void Run(uint64_t from, uint64_t to, Synth* out);
+    // Adds a change in output from a register write or frame counter step.
+    void Emit(uint64_t cycle, Synth* out);
     void StepLength();
     void StepCounter();
 
@@ -17,12 +22,15 @@ class Triangle {
     void set_timer_low(uint8_t val);
     void set_timer_high(uint8_t val);
     inline uint16_t length() const { return length_value_; }
-    void DebugStuff();
+    // Level changes are also added to |scope| while it is set.
+    void set_scope(Scope* scope, uint64_t cycle);
+    void DebugStuff(const float* wave, int n);
     void LoadState(proto::APUTriangle *state);
     void SaveState(proto::APUTriangle *state);
   private:
     uint8_t InternalOutput();
     bool enabled_;
+    uint8_t level_;
 
     bool length_enabled_;
     uint8_t length_value_;
@@ -39,9 +47,7 @@ class Triangle {
     struct {
         uint8_t control, tlo, thi;
     } reg_;
-    const static int DBGBUFSZ = 1024;
-    float dbgbuf_[DBGBUFSZ];
-    int dbgp_;
+    Scope* scope_;
 };
 
 #endif // EMUDORE_SRC_NES_APU_TRIANGLE_H
@@ -0,0 +1,119 @@
+#include "src/nes/apu_vrc6.h"
+
+// One step of output.  A VRC6 pulse at full volume is about as loud as a
+// 2A03 pulse at full volume.
+static const float kGain = 95.52f / (8128.0f / 15 + 100) / 15;
+
+Vrc6::Vrc6()
+    : channel_{},
+    halt_(false),
+    shift_(0) {
+    channel_[0].step = channel_[1].step = 15;
+}
+
+void Vrc6::Write(uint16_t addr, uint8_t val) {
+    int n = (addr >> 12) - 9;
+    if (n < 0 || n > kSaw)
+        return;
+    if (addr == 0x9003) {
+        halt_ = val & 1;
+        shift_ = (val & 4) ? 8 : (val & 2) ? 4 : 0;
+        return;
+    }
+    Channel* c = &channel_[n];
+    switch(addr & 0xFFF) {
+    case 0:
+        if (n == kSaw) {
+            c->rate = val & 0x3F;
+        } else {
+            c->constant = val & 0x80;
+            c->duty = (val >> 4) & 7;
+            c->volume = val & 0x0F;
+        }
+        break;
+    case 1:
+        c->period = (c->period & 0xF00) | val;
+        break;
+    case 2:
+        c->period = (c->period & 0x0FF) | (val & 0x0F) << 8;
+        if (!(val & 0x80)) {
+            // Disabling resets the sequencer.
+            c->step = (n == kSaw) ? 0 : 15;
+            c->accumulator = 0;
+        } else if (!c->enabled) {
+            c->timer = (c->period >> shift_) + 1;
+        }
+        c->enabled = val & 0x80;
+        break;
+    default:
+        ;
+    }
+}
+
+uint8_t Vrc6::Output(int n) const {
+    const Channel& c = channel_[n];
+    if (!c.enabled)
+        return 0;
+    if (n == kSaw)
+        return c.accumulator >> 3;
+    return (c.constant || c.step <= c.duty) ? c.volume : 0;
+}
+
+void Vrc6::Clock(int n) {
+    Channel* c = &channel_[n];
+    if (n != kSaw) {
+        c->step = (c->step - 1) & 15;
+        return;
+    }
+    // The rate is added on every other step, and the sum is cleared on
+    // the seventh.
+    if (++c->step == 14) {
+        c->step = 0;
+        c->accumulator = 0;
+    } else if (!(c->step & 1)) {
+        c->accumulator += c->rate;
+    }
+}
+
+void Vrc6::Update(int n, uint64_t cycle, Synth* out) {
+    Channel* c = &channel_[n];
+    uint8_t val = Output(n);
+    if (val == c->level)
+        return;
+    out->Add(cycle, (float(val) - float(c->level)) * kGain);
+    c->level = val;
+}
+
+void Vrc6::RunChannel(int n, uint64_t from, uint64_t to, Synth* out) {
+    Channel* c = &channel_[n];
+    if (!c->enabled || halt_)
+        return;
+    uint64_t period = (c->period >> shift_) + 1;
+    uint64_t t = from + c->timer;
+    bool still = (n == kSaw) ? c->rate == 0 && c->accumulator == 0
+                             : c->constant || c->volume == 0;
+    if (still && t <= to) {
+        // The output can't change, so only the sequencer position matters.
+        uint64_t clocks = (to - t) / period + 1;
+        if (n == kSaw)
+            c->step = (c->step + clocks) % 14;
+        else
+            c->step = (c->step - clocks) & 15;
+        t += clocks * period;
+    }
+    for(; t <= to; t += period) {
+        Clock(n);
+        Update(n, t, out);
+    }
+    c->timer = uint32_t(t - to);
+}
+
+void Vrc6::Run(uint64_t from, uint64_t to, Synth* out) {
+    for(int n=0; n<3; n++)
+        RunChannel(n, from, to, out);
+}
+
+void Vrc6::Emit(uint64_t cycle, Synth* out) {
+    for(int n=0; n<3; n++)
+        Update(n, cycle, out);
+}
@@ -0,0 +1,41 @@
+#ifndef EMUDORE_SRC_NES_APU_VRC6_H
+#define EMUDORE_SRC_NES_APU_VRC6_H
+#include <cstdint>
+
+#include "src/nes/apu_expansion.h"
+
+// Konami VRC6 sound: two pulses with 16-step duty cycles and a sawtooth.
+// The registers are at $9000-$9003, $A000-$A002 and $B000-$B002.
+class Vrc6: public ExpansionAudio {
+  public:
+    Vrc6();
+    void Write(uint16_t addr, uint8_t val) override;
+    void Run(uint64_t from, uint64_t to, Synth* out) override;
+    void Emit(uint64_t cycle, Synth* out) override;
+  private:
+    struct Channel {
+        bool enabled;
+        bool constant;
+        uint8_t duty;
+        uint8_t volume;
+        uint16_t period;
+        // Cycles until the timer next clocks the sequencer.
+        uint32_t timer;
+        uint8_t step;
+        // The sawtooth's rate and running sum.
+        uint8_t rate;
+        uint8_t accumulator;
+        uint8_t level;
+    };
+    static const int kSaw = 2;
+    uint8_t Output(int n) const;
+    void Clock(int n);
+    void Update(int n, uint64_t cycle, Synth* out);
+    void RunChannel(int n, uint64_t from, uint64_t to, Synth* out);
+
+    Channel channel_[3];
+    bool halt_;
+    uint8_t shift_;
+};
+
+#endif // EMUDORE_SRC_NES_APU_VRC6_H
@@ -0,0 +1,163 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "src/nes/breakpoints.h"
+#include "src/nes/mapper.h"
+#include "src/nes/mem.h"
+
+static const char* kind_name[] = { "read", "write", "exec" };
+
+Breakpoints::Breakpoints(NES* nes)
+  : nes_(nes),
+    bitmap_{{0,}} {}
+
+void Breakpoints::Add(Kind kind, const Breakpoint& bp) {
+    list_[kind].push_back(bp);
+    Update(kind);
+}
+
+bool Breakpoints::Remove(Kind kind, unsigned int index) {
+    if (index >= list_[kind].size())
+        return false;
+    list_[kind].erase(list_[kind].begin() + index);
+    Update(kind);
+    return true;
+}
+
+void Breakpoints::Update(Kind kind) {
+    memset(bitmap_[kind], 0, sizeof(bitmap_[kind]));
+    for(const auto& bp : list_[kind])
+        bitmap_[kind][bp.addr / 64] |= uint64_t(1) << (bp.addr % 64);
+
+    std::function<void(Cpu*, uint16_t, uint8_t)> hook;
+    if (!list_[kind].empty()) {
+        hook = [this, kind](Cpu* cpu, uint16_t addr, uint8_t val) {
+            if (Test(kind, addr))
+                Check(kind, cpu, addr, val);
+        };
+    }
+    switch(kind) {
+    case READ: nes_->cpu()->set_read_cb(hook); break;
+    case WRITE: nes_->cpu()->set_write_cb(hook); break;
+    case EXEC: nes_->cpu()->set_exec_cb(hook); break;
+    default:
+        ;
+    }
+}
+
+void Breakpoints::Check(Kind kind, Cpu* cpu, uint16_t addr, uint8_t val) {
+    int bank = -2;
+    for(auto& bp : list_[kind]) {
+        if (bp.addr != addr || (bp.val != -1 && bp.val != val))
+            continue;
+        if (bp.bank != -1) {
+            if (bank == -2) {
+                int offset = nes_->mapper()->PrgOffset(addr);
+                bank = offset < 0 ? -1 : offset / 0x2000;
+            }
+            if (bp.bank != bank)
+                continue;
+        }
+        if (bp.cond && !bp.cond->Evaluate(nes_, addr, val))
+            continue;
+        bp.hits++;
+        if (bp.pause)
+            nes_->Pause();
+        uint16_t sp = 0x100 | cpu->sp();
+        uint16_t tos = nes_->memory()->read_byte_no_io(sp+1) |
+                       nes_->memory()->read_byte_no_io(sp+2) << 8;
+        nes_->console()->AddLog(
+                "[%s #%d] PC=%04x %04x=%02x.  A=%02x X=%02x Y=%02x SP=%04x[%04x]",
+                kind_name[kind], int(&bp - &list_[kind][0]), cpu->pc(),
+                addr, val, cpu->a(), cpu->x(), cpu->y(), sp, tos);
+    }
+}
+
+void Breakpoints::List(Kind kind) {
+    DebugConsole* console = nes_->console();
+    console->AddLog("Watches (type=%s):", kind_name[kind]);
+    for(unsigned int i=0; i<list_[kind].size(); i++) {
+        const auto& bp = list_[kind][i];
+        char bank[8] = "";
+        if (bp.bank >= 0)
+            sprintf(bank, "%02x:", bp.bank);
+        console->AddLog("%u: %s%04x = %x%s%s%s  (%lu hits)", i, bank, bp.addr,
+                        bp.val, bp.pause ? " break" : "",
+                        bp.cond ? " if " : "",
+                        bp.cond ? bp.cond->text().c_str() : "",
+                        (unsigned long)bp.hits);
+    }
+}
+
+static Breakpoints::Kind CommandKind(const char* cmd) {
+    // setw/delw, setwx/delwx, setwr/delwr
+    switch(cmd[4]) {
+    case 'x': return Breakpoints::EXEC;
+    case 'r': return Breakpoints::READ;
+    default: return Breakpoints::WRITE;
+    }
+}
+
+void Breakpoints::SetCommand(int argc, char **argv) {
+    Kind kind = CommandKind(argv[0]);
+    if (argc < 2) {
+        nes_->console()->AddLog("[error] %s: Wrong number of arguments.", argv[0]);
+        nes_->console()->AddLog("[error] %s <[bank:]addr> [val] [break] "
+                                "[if <expr>]", argv[0]);
+        List(kind);
+        return;
+    }
+
+    Breakpoint bp = {0, -1, -1, false, nullptr, 0};
+    // Both parts read like every other console number: 0x for hex.
+    char *end;
+    unsigned long n = strtoul(argv[1], &end, 0);
+    if (*end == ':') {
+        bp.bank = n;
+        bp.addr = strtoul(end+1, 0, 0);
+    } else {
+        bp.addr = n;
+    }
+    int i = 2;
+    if (i < argc && strcmp(argv[i], "break") && strcmp(argv[i], "if"))
+        bp.val = strtoul(argv[i++], 0, 0);
+    if (i < argc && !strcmp(argv[i], "break")) {
+        bp.pause = true;
+        i++;
+    }
+    if (i < argc && !strcmp(argv[i], "if")) {
+        // The console splits on spaces; glue the expression back together.
+        std::string text;
+        for(i++; i < argc; i++) {
+            text += argv[i];
+            text += " ";
+        }
+        std::string error;
+        bp.cond = std::make_shared<Expression>();
+        if (!bp.cond->Compile(text, &error)) {
+            nes_->console()->AddLog("[error] %s: %s", argv[0], error.c_str());
+            return;
+        }
+    }
+    if (i < argc) {
+        nes_->console()->AddLog("[error] %s: Unexpected argument %s",
+                                argv[0], argv[i]);
+        return;
+    }
+
+    Add(kind, bp);
+    List(kind);
+}
+
+void Breakpoints::DelCommand(int argc, char **argv) {
+    Kind kind = CommandKind(argv[0]);
+    if (argc < 2) {
+        nes_->console()->AddLog("[error] %s: Wrong number of arguments.", argv[0]);
+        nes_->console()->AddLog("[error] %s <index>", argv[0]);
+        List(kind);
+        return;
+    }
+    Remove(kind, strtoul(argv[1], 0, 0));
+    List(kind);
+}
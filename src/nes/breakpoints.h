@@ -0,0 +1,59 @@
+#ifndef EMUDORE_SRC_NES_BREAKPOINTS_H
+#define EMUDORE_SRC_NES_BREAKPOINTS_H
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "src/cpu2.h"
+#include "src/nes/expr.h"
+#include "src/nes/nes.h"
+
+// Read, write and exec watchpoints.
+//
+// Each access kind has a 64K-bit bitmap of watched addresses, so the CPU
+// hook costs one bit test per access; only hits are checked against the
+// full watch list for bank and value qualification.  The CPU hooks are
+// only installed while at least one watch of that kind exists.
+//
+// A watch may carry a condition (see expr.h), compiled when the watch is
+// set and evaluated only after the address and value already match, and
+// may pause emulation instead of just logging.
+class Breakpoints {
+  public:
+    enum Kind {
+        READ,
+        WRITE,
+        EXEC,
+        NKINDS,
+    };
+    struct Breakpoint {
+        uint16_t addr;
+        int bank;       // 8KiB PRG bank mapped at addr, or -1 for any.
+        int val;        // Value read/written (opcode for EXEC), or -1.
+        bool pause;     // Pause emulation on a hit.
+        std::shared_ptr<Expression> cond;
+        uint64_t hits;
+    };
+    Breakpoints(NES* nes);
+
+    void Add(Kind kind, const Breakpoint& bp);
+    bool Remove(Kind kind, unsigned int index);
+    void List(Kind kind);
+
+    inline bool Test(Kind kind, uint16_t addr) const {
+        return (bitmap_[kind][addr / 64] >> (addr % 64)) & 1;
+    }
+
+    void SetCommand(int argc, char **argv);
+    void DelCommand(int argc, char **argv);
+
+  private:
+    void Update(Kind kind);
+    void Check(Kind kind, Cpu* cpu, uint16_t addr, uint8_t val);
+
+    NES* nes_;
+    std::vector<Breakpoint> list_[NKINDS];
+    uint64_t bitmap_[NKINDS][65536 / 64];
+};
+
+#endif // EMUDORE_SRC_NES_BREAKPOINTS_H
@@ -1,9 +1,12 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstdint>
+#include <cstring>
+#include <vector>
 #include <gflags/gflags.h>
 
 #include "src/nes/cartridge.h"
+#include "src/nes/mem.h"
 
 DEFINE_bool(sram_on_disk, true, "Save SRAM to disk.");
 
@@ -11,7 +14,9 @@ Cartridge::Cartridge(NES* nes)
     : nes_(nes),
     prg_(nullptr), prglen_(0),
     chr_(nullptr), chrlen_(0),
-    trainer_(nullptr) {
+    trainer_(nullptr),
+    mirror_(HORIZONTAL),
+    vram_{0, } {
 }
 
 
@@ -35,7 +40,8 @@ void Cartridge::LoadFile(const std::string& filename) {
     }
     PrintHeader();
 
-    mirror_ = MirrorMode(header_.mirror0 | (header_.mirror1 << 1));
+    // The second bit is four-screen VRAM, which overrides the first.
+    set_mirror(header_.mirror1 ? FOUR : MirrorMode(header_.mirror0));
     prglen_ = 16384 * header_.prgsz;
     prg_ = new uint8_t[prglen_];
 
@@ -65,6 +71,7 @@ void Cartridge::LoadFile(const std::string& filename) {
         abort();
     }
     fclose(fp);
+    tiles_.Reset(chr_, chrlen_);
 
     sram_filename_ = filename + ".sram";
     if (FLAGS_sram_on_disk && header_.sram) {
@@ -77,6 +84,60 @@ void Cartridge::LoadFile(const std::string& filename) {
     }
 }
 
+bool Cartridge::IsNsf(const std::string& filename) {
+    FILE* fp = fopen(filename.c_str(), "rb");
+    char sig[5];
+    if (fp == nullptr)
+        return false;
+    bool nsf = fread(sig, sizeof(sig), 1, fp) == 1 &&
+               memcmp(sig, "NESM\x1a", sizeof(sig)) == 0;
+    fclose(fp);
+    return nsf;
+}
+
+void Cartridge::LoadNsf(const std::string& filename) {
+    FILE* fp = fopen(filename.c_str(), "rb");
+
+    if (fp == nullptr) {
+        fprintf(stderr, "Couldn't read %s.\n", filename.c_str());
+        abort();
+    }
+    if (fread(&nsf_, sizeof(nsf_), 1, fp) != 1 ||
+        memcmp(nsf_.signature, "NESM\x1a", sizeof(nsf_.signature)) != 0) {
+        fprintf(stderr, "Couldn't read NSF header.\n");
+        abort();
+    }
+    std::vector<uint8_t> data;
+    uint8_t buf[4096];
+    size_t n;
+    while((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+        data.insert(data.end(), buf, buf + n);
+    fclose(fp);
+
+    bool banked = false;
+    for(int i=0; i<8; i++)
+        banked |= nsf_.bank[i] != 0;
+    if (!banked && nsf_.load < 0x8000) {
+        fprintf(stderr, "NSF load address %04x is below $8000.\n", nsf_.load);
+        abort();
+    }
+    // Bankswitched data starts at the load address' offset in its page.
+    uint32_t pad = banked ? nsf_.load & 0xFFF : nsf_.load - 0x8000;
+    prglen_ = (pad + data.size() + 0xFFF) & ~0xFFF;
+    if (prglen_ < 0x8000)
+        prglen_ = 0x8000;
+    prg_ = new uint8_t[prglen_]();
+    memcpy(prg_ + pad, data.data(), data.size());
+
+    // There is no PPU to speak of, but mappers expect CHR to exist.
+    memset(&header_, 0, sizeof(header_));
+    chrlen_ = 8192;
+    chr_ = new uint8_t[chrlen_]();
+    tiles_.Reset(chr_, chrlen_);
+    sram_filename_ = filename + ".sram";
+    PrintNsfHeader();
+}
+
 void Cartridge::Emulate() {
     static uint64_t save_frame;
 
@@ -101,15 +162,25 @@ void Cartridge::SaveSram() {
     fclose(fp);
 }
 
+void Cartridge::set_mirror(MirrorMode m) {
+    mirror_ = m;
+    nes_->memory()->SetMirror(m);
+}
+
 void Cartridge::SaveState(proto::Mapper *state) {
     auto* wram = state->mutable_wram();
     wram->assign((char*)sram_, sizeof(sram_));
+    if (mirror_ == FOUR)
+        state->mutable_vram()->assign((char*)vram_, sizeof(vram_));
 }
 
 void Cartridge::LoadState(proto::Mapper *state) {
     const auto& wram = state->wram();
     memcpy(sram_, wram.data(),
            wram.size() < sizeof(sram_) ? wram.size() : sizeof(sram_));
+    const auto& vram = state->vram();
+    memcpy(vram_, vram.data(),
+           vram.size() < sizeof(vram_) ? vram.size() : sizeof(vram_));
 }
 
 void Cartridge::PrintHeader() {
@@ -130,3 +201,21 @@ void Cartridge::PrintHeader() {
     printf("  Has trainer: %d\n", header_.trainer);
     printf("  Mapper: %d\n", mapper());
 }
+
+void Cartridge::PrintNsfHeader() {
+    printf("NSF header:\n");
+    printf("  Version: %d\n", nsf_.version);
+    printf("  Name: %.32s\n", nsf_.name);
+    printf("  Artist: %.32s\n", nsf_.artist);
+    printf("  Copyright: %.32s\n", nsf_.copyright);
+    printf("  Songs: %d (starting at %d)\n", nsf_.songs, nsf_.start);
+    printf("  Load: %04x  Init: %04x  Play: %04x\n",
+           nsf_.load, nsf_.init, nsf_.play);
+    printf("  Speed: %d us\n", nsf_.ntsc_speed);
+    printf("  Banks: %02x %02x %02x %02x %02x %02x %02x %02x\n",
+           nsf_.bank[0], nsf_.bank[1], nsf_.bank[2], nsf_.bank[3],
+           nsf_.bank[4], nsf_.bank[5], nsf_.bank[6], nsf_.bank[7]);
+    if (nsf_.chips & ~0x01)
+        printf("  Expansion audio %02x is not supported.\n",
+               nsf_.chips & ~0x01);
+}
@@ -4,6 +4,7 @@
 #include <cstdint>
 
 #include "src/nes/nes.h"
+#include "src/nes/tile_cache.h"
 #include "proto/mappers.pb.h"
 
 class Cartridge {
@@ -23,6 +24,25 @@ class Cartridge {
         uint8_t mapperh: 4;
         uint8_t unused[8];
     };
+    // The 128-byte header of an NES Sound Format file.
+    struct NsfHeader {
+        char signature[5];
+        uint8_t version;
+        uint8_t songs;
+        uint8_t start;
+        uint16_t load;
+        uint16_t init;
+        uint16_t play;
+        char name[32];
+        char artist[32];
+        char copyright[32];
+        uint16_t ntsc_speed;
+        uint8_t bank[8];
+        uint16_t pal_speed;
+        uint8_t region;
+        uint8_t chips;
+        uint8_t unused[4];
+    };
     enum MirrorMode {
         HORIZONTAL,
         VERTICAL,
@@ -34,9 +54,15 @@ class Cartridge {
     ~Cartridge();
 
     void LoadFile(const std::string& filename);
+    // Loads an NSF file's data as 4K pages of PRG.  Without bankswitching,
+    // the data is placed at its load address in the first eight pages.
+    void LoadNsf(const std::string& filename);
+    static bool IsNsf(const std::string& filename);
     void PrintHeader();
+    void PrintNsfHeader();
+    inline const NsfHeader& nsf() const { return nsf_; }
     inline uint8_t mirror() const { return mirror_; }
-    inline void set_mirror(MirrorMode m) { mirror_ = m; }
+    void set_mirror(MirrorMode m);
     inline bool battery() const {
         return header_.sram;
     }
@@ -45,13 +71,20 @@ class Cartridge {
     }
     inline uint32_t prglen() const { return prglen_; }
     inline uint32_t chrlen() const { return chrlen_; }
+    inline bool chr_ram() const { return header_.chrsz == 0; }
+    inline TileCache* tiles() { return &tiles_; }
 
     inline uint8_t ReadPrg(uint32_t addr) { return prg_[addr]; }
     inline uint8_t ReadChr(uint32_t addr) { return chr_[addr]; }
     inline uint8_t ReadSram(uint32_t addr) { return sram_[addr]; }
     inline void WritePrg(uint32_t addr, uint8_t val) { prg_[addr] = val; }
-    inline void WriteChr(uint32_t addr, uint8_t val) { chr_[addr] = val; }
+    inline void WriteChr(uint32_t addr, uint8_t val) {
+        chr_[addr] = val;
+        tiles_.Invalidate(addr);
+    }
     inline void WriteSram(uint32_t addr, uint8_t val) { sram_[addr] = val; }
+    // Nametable RAM on the cartridge, for four-screen boards.
+    inline uint8_t* vram() { return vram_; }
 
     void Emulate();
     void SaveSram();
@@ -61,13 +94,16 @@ class Cartridge {
   private:
     NES* nes_;
     struct iNESHeader header_;
+    struct NsfHeader nsf_;
     uint8_t *prg_;
     uint32_t prglen_;
     uint8_t *chr_;
     uint32_t chrlen_;
+    TileCache tiles_;
     uint8_t *trainer_;
     MirrorMode mirror_;
     uint8_t sram_[0x2000];
+    uint8_t vram_[0x800];
     std::string sram_filename_;
 };
 
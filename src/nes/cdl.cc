@@ -0,0 +1,108 @@
+#include <cstdio>
+
+#include "src/nes/cdl.h"
+#include "src/nes/cartridge.h"
+#include "src/nes/mem.h"
+#include "src/nes/ppu.h"
+
+CodeDataLogger::CodeDataLogger(NES* nes)
+  : nes_(nes),
+    running_(false),
+    access_(DATA) {}
+
+void CodeDataLogger::Resize() {
+    prg_.resize(nes_->cartridge()->prglen());
+    chr_.resize(nes_->cartridge()->chrlen());
+}
+
+void CodeDataLogger::Start() {
+    Resize();
+    running_ = true;
+    nes_->memory()->set_cdl(this);
+    nes_->ppu()->set_cdl(this);
+}
+
+void CodeDataLogger::Stop() {
+    running_ = false;
+    nes_->memory()->set_cdl(nullptr);
+    nes_->ppu()->set_cdl(nullptr);
+}
+
+void CodeDataLogger::Clear() {
+    prg_.assign(prg_.size(), 0);
+    chr_.assign(chr_.size(), 0);
+}
+
+bool CodeDataLogger::Save(const std::string& filename) {
+    Resize();
+    FILE* fp = fopen(filename.c_str(), "wb");
+    if (fp == nullptr)
+        return false;
+    fwrite(prg_.data(), 1, prg_.size(), fp);
+    // FCEUX only logs CHR ROM; carts with CHR RAM have no CHR section.
+    if (!nes_->cartridge()->chr_ram())
+        fwrite(chr_.data(), 1, chr_.size(), fp);
+    fclose(fp);
+    return true;
+}
+
+bool CodeDataLogger::Load(const std::string& filename) {
+    Resize();
+    FILE* fp = fopen(filename.c_str(), "rb");
+    if (fp == nullptr)
+        return false;
+
+    size_t chrlen = nes_->cartridge()->chr_ram() ? 0 : chr_.size();
+    std::vector<uint8_t> data(prg_.size() + chrlen + 1);
+    size_t len = fread(data.data(), 1, data.size(), fp);
+    fclose(fp);
+    if (len != prg_.size() + chrlen)
+        return false;
+
+    for(size_t i=0; i<prg_.size(); i++)
+        prg_[i] |= data[i];
+    for(size_t i=0; i<chrlen; i++)
+        chr_[i] |= data[prg_.size() + i];
+    return true;
+}
+
+void CodeDataLogger::Command(int argc, char **argv) {
+    DebugConsole* console = nes_->console();
+    if (argc < 2) {
+        console->AddLog("[error] %s: Wrong number of arguments.", argv[0]);
+        console->AddLog("[error] %s <start|stop|clear|stats|save <file>"
+                        "|load <file>>", argv[0]);
+        return;
+    }
+    std::string cmd(argv[1]);
+    if (cmd == "start") {
+        Start();
+    } else if (cmd == "stop") {
+        Stop();
+    } else if (cmd == "clear") {
+        Clear();
+    } else if (cmd == "stats") {
+        int code = 0, data = 0, rendered = 0, read = 0;
+        for(const auto& f : prg_) {
+            if (f & CODE) code++;
+            if (f & DATA) data++;
+        }
+        for(const auto& f : chr_) {
+            if (f & RENDERED) rendered++;
+            if (f & READ) read++;
+        }
+        console->AddLog("CDL %s", running_ ? "running" : "stopped");
+        console->AddLog("PRG: %d code, %d data of %d bytes",
+                        code, data, int(prg_.size()));
+        console->AddLog("CHR: %d rendered, %d read of %d bytes",
+                        rendered, read, int(chr_.size()));
+    } else if (cmd == "save" && argc == 3) {
+        if (!Save(argv[2]))
+            console->AddLog("[error] Could not write %s", argv[2]);
+    } else if (cmd == "load" && argc == 3) {
+        if (!Load(argv[2]))
+            console->AddLog("[error] Could not merge %s", argv[2]);
+    } else {
+        console->AddLog("[error] %s: Unknown subcommand %s", argv[0], argv[1]);
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef EMUDORE_SRC_NES_CDL_H
+#define EMUDORE_SRC_NES_CDL_H
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "src/nes/nes.h"
+
+// Code/Data Logger.  Records how each byte of PRG and CHR ROM is used,
+// indexed by ROM offset, using the same flag layout as FCEUX .cdl files.
+//
+// Mem and PPU hold a pointer to the logger only while it is running, so
+// a stopped logger costs one null check on the ROM read paths.
+class CodeDataLogger {
+  public:
+    enum PrgFlags {
+        CODE = 0x01,
+        DATA = 0x02,
+        BANK = 0x0C,            // CPU address bits 13-14 of the access
+        INDIRECT_CODE = 0x10,
+        INDIRECT_DATA = 0x20,
+        PCM = 0x40,
+    };
+    enum ChrFlags {
+        RENDERED = 0x01,
+        READ = 0x02,
+    };
+    CodeDataLogger(NES* nes);
+
+    void Start();
+    void Stop();
+    inline bool running() const { return running_; }
+    inline const std::vector<uint8_t>& prg() const { return prg_; }
+
+    // Set the kind of PRG access performed by following reads.
+    inline void set_access(uint8_t flags) { access_ = flags; }
+
+    inline void LogPrg(int offset, uint16_t addr) {
+        if (offset >= 0)
+            prg_[offset] |= access_ | ((addr >> 11) & BANK);
+    }
+    inline void LogChr(int offset, uint8_t flags) {
+        if (offset >= 0)
+            chr_[offset] |= flags;
+    }
+
+    // Writes an FCEUX compatible .cdl file.
+    bool Save(const std::string& filename);
+    // Merges a previously saved .cdl file into the current log.
+    bool Load(const std::string& filename);
+    void Clear();
+
+    void Command(int argc, char **argv);
+
+  private:
+    void Resize();
+
+    NES* nes_;
+    bool running_;
+    uint8_t access_;
+    std::vector<uint8_t> prg_;
+    std::vector<uint8_t> chr_;
+};
+
+#endif // EMUDORE_SRC_NES_CDL_H
@@ -1,5 +1,6 @@
 #ifndef EMUDORE_SRC_NES_CONTROLLER_H
 #define EMUDORE_SRC_NES_CONTROLLER_H
+#include <atomic>
 #include <cstdint>
 #include <vector>
 #include <SDL2/SDL.h>
@@ -27,7 +28,8 @@ class Controller {
     static const int BUTTON_RIGHT  = 0x80;
   private:
     NES* nes_;
-    uint8_t buttons_;
+    // Also shown by the debug window, which doesn't suspend the emulator.
+    std::atomic<uint8_t> buttons_;
     int index_, strobe_;
     std::vector<uint8_t> movie_;
     bool got_read_;
@@ -0,0 +1,370 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include "imgui.h"
+
+#include "src/nes/disasm.h"
+#include "src/cpu2.h"
+#include "src/nes/cartridge.h"
+#include "src/nes/cdl.h"
+#include "src/nes/mapper.h"
+#include "src/nes/mem.h"
+
+Disassembly::Disassembly(NES* nes)
+  : nes_(nes),
+    dirty_(false) {}
+
+void Disassembly::Reset() {
+    int n = nes_->cartridge()->prglen();
+    type_.assign(n, UNKNOWN);
+    base_.assign((n + kBankSize - 1) / kBankSize, 0);
+    xrefs_.clear();
+    targets_.clear();
+    vectors_.clear();
+    work_.clear();
+    lines_.clear();
+    line_of_.assign(n, 0);
+    dirty_ = true;
+
+    static const struct {
+        uint16_t addr;
+        const char* name;
+    } vectors[] = {
+        { 0xFFFA, "NMI" },
+        { 0xFFFC, "RESET" },
+        { 0xFFFE, "IRQ" },
+    };
+    Mem* mem = nes_->memory();
+    for(const auto& v : vectors) {
+        uint16_t addr = mem->read_byte_no_io(v.addr) |
+                        mem->read_byte_no_io(v.addr + 1) << 8;
+        int offset = Seed(addr);
+        if (offset >= 0 && vectors_.find(offset) == vectors_.end()) {
+            vectors_[offset] = v.name;
+            type_[offset] |= VECTOR;
+        }
+    }
+}
+
+int Disassembly::Seed(uint16_t addr) {
+    int offset = nes_->mapper()->PrgOffset(addr);
+    if (offset < 0 || offset >= int(type_.size()))
+        return -1;
+    int bank = offset / kBankSize;
+    if (base_[bank] == 0)
+        base_[bank] = addr & ~(kBankSize - 1);
+    if (!(type_[offset] & CODE))
+        work_.push_back(offset);
+    return offset;
+}
+
+void Disassembly::SeedFromCdl() {
+    const auto& cdl = nes_->cdl()->prg();
+    if (cdl.size() != type_.size())
+        return;
+    // The CDL marks operands as code too, so only the start of each run of
+    // code is known to be an instruction.  Indirect jump targets always are.
+    for(size_t i=0; i<cdl.size(); i++) {
+        uint8_t f = cdl[i];
+        bool start = (f & CodeDataLogger::INDIRECT_CODE) ||
+            ((f & CodeDataLogger::CODE) &&
+             (i == 0 || !(cdl[i-1] & CodeDataLogger::CODE)));
+        if (!start || (type_[i] & (CODE | OPERAND)))
+            continue;
+        int bank = i / kBankSize;
+        if (base_[bank] == 0)
+            base_[bank] = 0x8000 | (f & CodeDataLogger::BANK) << 11;
+        work_.push_back(i);
+    }
+}
+
+uint16_t Disassembly::Address(int offset) {
+    uint16_t base = base_[offset / kBankSize];
+    return base ? base + offset % kBankSize : 0;
+}
+
+int Disassembly::Resolve(int from, uint16_t target) {
+    if (target < 0x8000)
+        return -1;
+    int bank = from / kBankSize;
+    uint16_t base = base_[bank];
+    if (base && target >= base && target - base < kBankSize)
+        return bank * kBankSize + (target - base);
+
+    // Elsewhere in the CPU window: assume the bank mapped there now, which
+    // is right for fixed banks, as long as it wasn't seen somewhere else.
+    int offset = nes_->mapper()->PrgOffset(target);
+    if (offset < 0 || offset >= int(type_.size()))
+        return -1;
+    uint16_t window = target & ~(kBankSize - 1);
+    uint16_t& tbase = base_[offset / kBankSize];
+    if (tbase == 0)
+        tbase = window;
+    return tbase == window ? offset : -1;
+}
+
+void Disassembly::AddXref(int target, int from, Type type) {
+    if (target < 0)
+        return;
+    type_[target] |= type;
+    xrefs_[target].push_back(from);
+    targets_[from] = target;
+    if (!(type_[target] & CODE))
+        work_.push_back(target);
+}
+
+int Disassembly::Trace(int offset, int budget) {
+    Cartridge* cart = nes_->cartridge();
+    int n = type_.size();
+    int traced = 0;
+
+    while(offset < n && !(type_[offset] & (CODE | OPERAND))) {
+        if (traced == budget) {
+            work_.push_back(offset);
+            break;
+        }
+        uint8_t opcode = cart->ReadPrg(offset);
+        Cpu::InstructionInfo info = Cpu::info(opcode);
+        int size = info.size;
+        if (size == 0 || offset + size > n)
+            break;
+
+        traced++;
+        type_[offset] |= CODE;
+        for(int i=1; i<size; i++)
+            type_[offset + i] |= OPERAND;
+        dirty_ = true;
+
+        // Running off the end of a bank continues in the next CPU window.
+        int bank = offset / kBankSize;
+        int next = (offset + size) / kBankSize;
+        if (next != bank && next < int(base_.size()) && base_[next] == 0 &&
+            base_[bank] && base_[bank] < 0xE000)
+            base_[next] = base_[bank] + kBankSize;
+
+        uint16_t operand = cart->ReadPrg(offset + 1);
+        if (size == 3)
+            operand |= cart->ReadPrg(offset + 2) << 8;
+        uint16_t pc = Address(offset);
+
+        if (info.mode == Cpu::Relative) {
+            if (pc)
+                AddXref(Resolve(offset, pc + 2 + int8_t(operand)),
+                        offset, LABEL);
+        } else {
+            switch(opcode) {
+            case 0x20:  // JSR
+                AddXref(Resolve(offset, operand), offset, SUB);
+                break;
+            case 0x4C:  // JMP abs
+                AddXref(Resolve(offset, operand), offset, LABEL);
+                return traced;
+            case 0x00:  // BRK
+            case 0x40:  // RTI
+            case 0x60:  // RTS
+            case 0x6C:  // JMP (ind)
+                return traced;
+            }
+        }
+        offset += size;
+    }
+    return traced;
+}
+
+void Disassembly::Step(int budget) {
+    while(budget > 0 && !work_.empty()) {
+        int offset = work_.back();
+        work_.pop_back();
+        // An entry that's already traced still costs something.
+        budget -= std::max(1, Trace(offset, budget));
+    }
+}
+
+void Disassembly::Reindex() {
+    int n = type_.size();
+    lines_.clear();
+    for(int offset=0; offset<n; ) {
+        int line = lines_.size();
+        int len = 1;
+        lines_.push_back(offset);
+        if (type_[offset] & CODE) {
+            len = Cpu::info(nes_->cartridge()->ReadPrg(offset)).size;
+        } else {
+            // Group data bytes, breaking at labels, code and banks.
+            while(len < kMaxDataBytes && offset + len < n &&
+                  (offset + len) % kBankSize != 0 &&
+                  !(type_[offset + len] & (CODE | LABEL | SUB | VECTOR)))
+                len++;
+        }
+        for(int i=0; i<len && offset < n; i++)
+            line_of_[offset++] = line;
+    }
+    dirty_ = false;
+}
+
+int Disassembly::lines() {
+    if (dirty_ && (work_.empty() || lines_.empty()))
+        Reindex();
+    return lines_.size();
+}
+
+int Disassembly::LineOf(int offset) {
+    lines();
+    if (offset < 0 || offset >= int(line_of_.size()))
+        return -1;
+    return line_of_[offset];
+}
+
+std::string Disassembly::Label(int offset) {
+    char buf[16];
+    auto v = vectors_.find(offset);
+    if (v != vectors_.end())
+        return v->second;
+    if (!(type_[offset] & (LABEL | SUB)))
+        return "";
+    char prefix = (type_[offset] & SUB) ? 'S' : 'L';
+    uint16_t addr = Address(offset);
+    if (addr)
+        sprintf(buf, "%c%02x_%04x", prefix, offset / kBankSize, addr);
+    else
+        sprintf(buf, "%c_%05x", prefix, offset);
+    return buf;
+}
+
+std::string Disassembly::Line(int n) {
+    char buf[160];
+    char *b = buf;
+    if (n < 0 || n >= lines())
+        return "";
+    Cartridge* cart = nes_->cartridge();
+    int offset = lines_[n];
+    uint16_t addr = Address(offset);
+
+    if (addr)
+        b += sprintf(b, "%02x:%04x  ", offset / kBankSize, addr);
+    else
+        b += sprintf(b, "%02x:????  ", offset / kBankSize);
+    b += sprintf(b, "%-11s ", Label(offset).c_str());
+
+    if (!(type_[offset] & CODE)) {
+        int end = n + 1 < int(lines_.size()) ? lines_[n + 1] : type_.size();
+        b += sprintf(b, ".db ");
+        for(int i=offset; i<end; i++)
+            b += sprintf(b, "%s$%02x", i == offset ? "" : ",",
+                         cart->ReadPrg(i));
+        return buf;
+    }
+
+    uint8_t opcode = cart->ReadPrg(offset);
+    Cpu::InstructionInfo info = Cpu::info(opcode);
+    uint16_t operand = 0;
+    switch(info.size) {
+    case 1:
+        b += sprintf(b, "%02x        ", opcode);
+        break;
+    case 2:
+        operand = cart->ReadPrg(offset + 1);
+        b += sprintf(b, "%02x %02x     ", opcode, operand);
+        break;
+    case 3:
+        operand = cart->ReadPrg(offset + 1) | cart->ReadPrg(offset + 2) << 8;
+        b += sprintf(b, "%02x %02x %02x  ", opcode, operand & 0xFF,
+                     operand >> 8);
+        break;
+    }
+
+    // Show control transfers by label when tracing found the target.
+    auto target = targets_.find(offset);
+    std::string label = target != targets_.end() ? Label(target->second) : "";
+    if (!label.empty()) {
+        b += sprintf(b, "%.3s %s", Cpu::instruction_name(opcode),
+                     label.c_str());
+    } else if (info.mode == Cpu::Relative && addr) {
+        b += sprintf(b, "%.3s $%04x", Cpu::instruction_name(opcode),
+                     uint16_t(addr + 2 + int8_t(operand)));
+    } else {
+        b += sprintf(b, Cpu::instruction_name(opcode), operand);
+    }
+
+    auto x = xrefs_.find(offset);
+    if (x != xrefs_.end()) {
+        const auto& from = x->second;
+        b += sprintf(b, "  ;");
+        for(size_t i=0; i<from.size() && i<3; i++) {
+            b += sprintf(b, " %02x:%04x", from[i] / kBankSize,
+                         Address(from[i]));
+        }
+        if (from.size() > 3)
+            b += sprintf(b, " +%d", int(from.size() - 3));
+    }
+    return buf;
+}
+
+void Disassembly::DebugStuff(bool* active) {
+    static char gotobuf[8];
+    static int goto_line = -1;
+
+    if (!*active)
+        return;
+    nes_->Live();
+
+    ImGui::Begin("Disassembly", active);
+    int n = lines();
+    ImGui::Text("%d lines%s", n, busy() ? ", tracing..." : "");
+    ImGui::SameLine();
+    if (ImGui::Button("Seed from CDL"))
+        SeedFromCdl();
+    ImGui::SameLine();
+    if (ImGui::Button("Seed PC"))
+        Seed(nes_->cpu()->pc());
+    ImGui::SameLine();
+    if (ImGui::InputText("Goto", gotobuf, sizeof(gotobuf),
+                         ImGuiInputTextFlags_CharsHexadecimal |
+                         ImGuiInputTextFlags_EnterReturnsTrue)) {
+        goto_line = LineOf(nes_->mapper()->PrgOffset(strtoul(gotobuf, 0, 16)));
+    }
+    ImGui::Separator();
+
+    ImGui::BeginChild("listing");
+    float height = ImGui::GetTextLineHeightWithSpacing();
+    if (goto_line >= 0) {
+        ImGui::SetScrollY(goto_line * height);
+        goto_line = -1;
+    }
+    ImGuiListClipper clipper(n, height);
+    for(int i=clipper.DisplayStart; i<clipper.DisplayEnd; i++) {
+        std::string line = Line(i);
+        ImGui::TextUnformatted(line.c_str());
+    }
+    clipper.End();
+    ImGui::EndChild();
+    ImGui::End();
+}
+
+void Disassembly::Command(int argc, char **argv) {
+    DebugConsole* console = nes_->console();
+    if (argc < 2) {
+        console->AddLog("[error] %s: Wrong number of arguments.", argv[0]);
+        console->AddLog("[error] %s <reset|cdl|seed <addr>|stats>", argv[0]);
+        return;
+    }
+    std::string cmd(argv[1]);
+    if (cmd == "reset") {
+        Reset();
+    } else if (cmd == "cdl") {
+        SeedFromCdl();
+    } else if (cmd == "seed" && argc == 3) {
+        if (Seed(strtoul(argv[2], 0, 16)) < 0)
+            console->AddLog("[error] %s is not in PRG ROM", argv[2]);
+    } else if (cmd == "stats") {
+        int code = 0, labels = 0;
+        for(const auto& t : type_) {
+            if (t & CODE) code++;
+            if (t & (LABEL | SUB)) labels++;
+        }
+        console->AddLog("%d instructions, %d labels, %d lines%s",
+                        code, labels, lines(), busy() ? " (tracing)" : "");
+    } else {
+        console->AddLog("[error] %s: Unknown subcommand %s", argv[0], argv[1]);
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef EMUDORE_SRC_NES_DISASM_H
+#define EMUDORE_SRC_NES_DISASM_H
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "src/nes/nes.h"
+
+// Static disassembly of PRG ROM, indexed by ROM offset so that banked code
+// is listed once per bank rather than once per CPU address.
+//
+// Code is found by tracing control flow from the interrupt vectors and
+// from code the CDL has seen executed.  Tracing runs a bounded amount of
+// work per frame; the line index is rebuilt only once tracing settles, so
+// drawing a listing costs one formatted line per visible row.
+class Disassembly {
+  public:
+    Disassembly(NES* nes);
+
+    // Forgets everything and seeds tracing from the vectors.
+    void Reset();
+    // Queues the instruction at CPU address addr in the current mapping.
+    // Returns its ROM offset, or -1 if addr isn't mapped to PRG ROM.
+    int Seed(uint16_t addr);
+    // Queues the entry points of code runs recorded by the CDL.
+    void SeedFromCdl();
+    // Traces up to budget instructions.  Called once per frame.
+    void Step(int budget=2048);
+    inline bool busy() const { return !work_.empty(); }
+
+    int lines();
+    int LineOf(int offset);
+    std::string Line(int n);
+    std::string Label(int offset);
+
+    void DebugStuff(bool* active);
+    void Command(int argc, char **argv);
+
+  private:
+    enum Type {
+        UNKNOWN = 0,
+        CODE = 0x01,        // First byte of an instruction.
+        OPERAND = 0x02,
+        LABEL = 0x04,       // Branch or jump target.
+        SUB = 0x08,         // JSR target.
+        VECTOR = 0x10,
+    };
+    static const int kBankSize = 0x2000;
+    static const int kMaxDataBytes = 8;
+
+    int Resolve(int from, uint16_t target);
+    void AddXref(int target, int from, Type type);
+    // Traces the run of code at offset, up to budget instructions.  Returns
+    // how many it traced, and queues offset again if it ran out.
+    int Trace(int offset, int budget);
+    uint16_t Address(int offset);
+    void Reindex();
+
+    NES* nes_;
+    std::vector<uint8_t> type_;
+    // CPU window (8KiB aligned) each 8KiB bank was found in; 0 if unknown.
+    std::vector<uint16_t> base_;
+    std::unordered_map<int, std::vector<int>> xrefs_;
+    // Where each traced branch, JSR or JMP goes, resolved as it's traced so
+    // that drawing a line doesn't change the bank windows.
+    std::unordered_map<int, int> targets_;
+    std::unordered_map<int, const char*> vectors_;
+    std::vector<int> work_;
+
+    bool dirty_;
+    std::vector<int> lines_;
+    std::vector<int> line_of_;
+};
+
+#endif // EMUDORE_SRC_NES_DISASM_H
@@ -0,0 +1,300 @@
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+#include "src/nes/expr.h"
+#include "src/cpu2.h"
+#include "src/nes/mapper.h"
+#include "src/nes/mem.h"
+#include "src/nes/ppu.h"
+
+bool Expression::Compile(const std::string& text, std::string* error) {
+    text_ = text;
+    code_.clear();
+    p_ = text_.c_str();
+    error_ = error;
+    depth_ = 0;
+    max_depth_ = 0;
+
+    if (!Binary(0))
+        goto fail;
+    SkipSpace();
+    if (*p_) {
+        Error("unexpected text");
+        goto fail;
+    }
+    if (max_depth_ > kMaxStack) {
+        Error("expression too complex");
+        goto fail;
+    }
+    return true;
+fail:
+    code_.clear();
+    return false;
+}
+
+void Expression::SkipSpace() {
+    while(isspace(*p_))
+        p_++;
+}
+
+bool Expression::Match(const char* tok) {
+    SkipSpace();
+    size_t len = strlen(tok);
+    if (strncmp(p_, tok, len))
+        return false;
+    // Don't take the first half of "||", "&&", "<<", "<=", "!=" and friends.
+    if (len == 1 && strchr("|&<>!", tok[0]) &&
+        (p_[1] == '=' || (p_[1] == tok[0] && tok[0] != '!')))
+        return false;
+    p_ += len;
+    return true;
+}
+
+bool Expression::Error(const char* msg) {
+    if (error_) {
+        *error_ = msg;
+        *error_ += " at column ";
+        *error_ += std::to_string(p_ - text_.c_str() + 1);
+    }
+    return false;
+}
+
+void Expression::Emit(Opcode op, int32_t arg) {
+    switch(op) {
+    case PUSH: case REG_A: case REG_X: case REG_Y: case REG_SP: case REG_P:
+    case REG_PC: case FLAG: case ADDR: case VAL: case BANK: case SCANLINE:
+    case CYCLE: case FRAME:
+        depth_++;
+        break;
+    case LOAD: case NEG: case NOT: case CPL: case BOOL:
+        break;
+    default:
+        // Binary operators and the fall through path of the jumps pop one.
+        depth_--;
+    }
+    if (depth_ > max_depth_)
+        max_depth_ = depth_;
+    code_.push_back(Op{op, arg});
+}
+
+bool Expression::Binary(int level) {
+    if (level == kLevels)
+        return Unary();
+    if (!Binary(level + 1))
+        return false;
+
+    if (level < 2) {
+        // Short circuit "||" (level 0) and "&&" (level 1).
+        const char* tok = level == 0 ? "||" : "&&";
+        Opcode jump = level == 0 ? JTRUE : JFALSE;
+        while(Match(tok)) {
+            size_t fixup = code_.size();
+            Emit(jump);
+            if (!Binary(level + 1))
+                return false;
+            Emit(BOOL);
+            code_[fixup].arg = code_.size();
+        }
+        return true;
+    }
+
+    // Remaining levels, loosest first.  Within a level, longer tokens come
+    // first so "<<" is not taken as "<".
+    struct BinaryOp {
+        const char* tok;
+        Opcode op;
+    };
+    static const BinaryOp ops[kLevels][5] = {
+        {}, {},
+        { {"|", OR} },
+        { {"^", XOR} },
+        { {"&", AND} },
+        { {"==", EQ}, {"!=", NE} },
+        { {"<=", LE}, {">=", GE}, {"<", LT}, {">", GT} },
+        { {"<<", SHL}, {">>", SHR} },
+        { {"+", ADD}, {"-", SUB} },
+        { {"*", MUL}, {"/", DIV}, {"%", MOD} },
+    };
+    for(;;) {
+        const BinaryOp* b;
+        for(b = ops[level]; b->tok; b++) {
+            if (Match(b->tok))
+                break;
+        }
+        if (!b->tok)
+            return true;
+        if (!Binary(level + 1))
+            return false;
+        Emit(b->op);
+    }
+}
+
+bool Expression::Unary() {
+    if (Match("!")) {
+        if (!Unary()) return false;
+        Emit(NOT);
+    } else if (Match("~")) {
+        if (!Unary()) return false;
+        Emit(CPL);
+    } else if (Match("-")) {
+        if (!Unary()) return false;
+        Emit(NEG);
+    } else {
+        return Primary();
+    }
+    return true;
+}
+
+bool Expression::Primary() {
+    struct Operand {
+        const char* name;
+        Opcode op;
+        int32_t arg;
+    };
+    static const Operand operands[] = {
+        { "a", REG_A, 0 },
+        { "x", REG_X, 0 },
+        { "y", REG_Y, 0 },
+        { "sp", REG_SP, 0 },
+        { "s", REG_SP, 0 },
+        { "p", REG_P, 0 },
+        { "pc", REG_PC, 0 },
+        { "addr", ADDR, 0 },
+        { "val", VAL, 0 },
+        { "bank", BANK, 0 },
+        { "scanline", SCANLINE, 0 },
+        { "cycle", CYCLE, 0 },
+        { "dot", CYCLE, 0 },
+        { "frame", FRAME, 0 },
+        { "c", FLAG, 0 },
+        { "z", FLAG, 1 },
+        { "i", FLAG, 2 },
+        { "d", FLAG, 3 },
+        { "v", FLAG, 6 },
+        { "n", FLAG, 7 },
+    };
+
+    SkipSpace();
+    if (Match("(")) {
+        if (!Binary(0))
+            return false;
+        if (!Match(")"))
+            return Error("expected ')'");
+        return true;
+    }
+    if (Match("[")) {
+        if (!Binary(0))
+            return false;
+        if (!Match("]"))
+            return Error("expected ']'");
+        Emit(LOAD);
+        return true;
+    }
+
+    char *end = const_cast<char*>(p_);
+    if (*p_ == '$') {
+        unsigned long n = strtoul(p_ + 1, &end, 16);
+        if (end == p_ + 1)
+            return Error("expected hex digits");
+        p_ = end;
+        Emit(PUSH, n);
+        return true;
+    }
+    if (isdigit(*p_)) {
+        unsigned long n = strtoul(p_, &end, 0);
+        p_ = end;
+        Emit(PUSH, n);
+        return true;
+    }
+    if (isalpha(*p_) || *p_ == '_') {
+        const char* start = p_;
+        while(isalnum(*p_) || *p_ == '_')
+            p_++;
+        size_t len = p_ - start;
+        for(const auto& o : operands) {
+            if (strlen(o.name) != len || strncasecmp(o.name, start, len))
+                continue;
+            Emit(o.op, o.arg);
+            return true;
+        }
+        p_ = start;
+        return Error("unknown name");
+    }
+    if (*p_ == '\0')
+        return Error("unexpected end of expression");
+    return Error("unexpected character");
+}
+
+int32_t Expression::Evaluate(NES* nes, uint16_t addr, uint8_t val) const {
+    int32_t stack[kMaxStack];
+    int sp = -1;
+    Cpu* cpu = nes->cpu();
+    size_t n = code_.size();
+
+    for(size_t pc = 0; pc < n; pc++) {
+        const Op& op = code_[pc];
+        switch(op.op) {
+        case PUSH: stack[++sp] = op.arg; break;
+        case REG_A: stack[++sp] = cpu->a(); break;
+        case REG_X: stack[++sp] = cpu->x(); break;
+        case REG_Y: stack[++sp] = cpu->y(); break;
+        case REG_SP: stack[++sp] = cpu->sp(); break;
+        case REG_P: stack[++sp] = cpu->p(); break;
+        case REG_PC: stack[++sp] = cpu->pc(); break;
+        case FLAG: stack[++sp] = (cpu->p() >> op.arg) & 1; break;
+        case ADDR: stack[++sp] = addr; break;
+        case VAL: stack[++sp] = val; break;
+        case BANK: {
+            int offset = nes->mapper()->PrgOffset(addr);
+            stack[++sp] = offset < 0 ? -1 : offset / 0x2000;
+            break;
+        }
+        case SCANLINE: stack[++sp] = nes->ppu()->scanline(); break;
+        case CYCLE: stack[++sp] = nes->ppu()->cycle(); break;
+        case FRAME: stack[++sp] = int32_t(nes->frame()); break;
+        case LOAD:
+            stack[sp] = nes->memory()->read_byte_no_io(uint16_t(stack[sp]));
+            break;
+        case NEG: stack[sp] = -stack[sp]; break;
+        case NOT: stack[sp] = !stack[sp]; break;
+        case CPL: stack[sp] = ~stack[sp]; break;
+        case BOOL: stack[sp] = !!stack[sp]; break;
+#define BINOP(o, expr) \
+        case o: sp--; stack[sp] = (expr); break
+        BINOP(MUL, stack[sp] * stack[sp+1]);
+        BINOP(DIV, stack[sp+1] ? stack[sp] / stack[sp+1] : 0);
+        BINOP(MOD, stack[sp+1] ? stack[sp] % stack[sp+1] : 0);
+        BINOP(ADD, stack[sp] + stack[sp+1]);
+        BINOP(SUB, stack[sp] - stack[sp+1]);
+        BINOP(SHL, stack[sp] << (stack[sp+1] & 31));
+        BINOP(SHR, stack[sp] >> (stack[sp+1] & 31));
+        BINOP(LT, stack[sp] < stack[sp+1]);
+        BINOP(LE, stack[sp] <= stack[sp+1]);
+        BINOP(GT, stack[sp] > stack[sp+1]);
+        BINOP(GE, stack[sp] >= stack[sp+1]);
+        BINOP(EQ, stack[sp] == stack[sp+1]);
+        BINOP(NE, stack[sp] != stack[sp+1]);
+        BINOP(AND, stack[sp] & stack[sp+1]);
+        BINOP(XOR, stack[sp] ^ stack[sp+1]);
+        BINOP(OR, stack[sp] | stack[sp+1]);
+#undef BINOP
+        case JFALSE:
+            if (stack[sp] == 0)
+                pc = op.arg - 1;
+            else
+                sp--;
+            break;
+        case JTRUE:
+            if (stack[sp] != 0) {
+                stack[sp] = 1;
+                pc = op.arg - 1;
+            } else {
+                sp--;
+            }
+            break;
+        }
+    }
+    return sp == 0 ? stack[0] : 0;
+}
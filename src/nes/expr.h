@@ -0,0 +1,80 @@
+#ifndef EMUDORE_SRC_NES_EXPR_H
+#define EMUDORE_SRC_NES_EXPR_H
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "src/nes/nes.h"
+
+// A debugger condition such as "A==3 && [$70]>5 && scanline<20".
+//
+// The expression is parsed once by Compile() into a small stack bytecode,
+// so evaluating a breakpoint condition is a single pass over a few ops
+// with no allocation.
+//
+// Operands:
+//   A X Y SP P PC      CPU registers
+//   C Z I D V N        CPU flags (0 or 1)
+//   addr val           The watched address and the value read/written
+//   bank               8KiB PRG bank mapped at addr (-1 if not ROM)
+//   scanline cycle     PPU position
+//   frame              Frame number
+//   [expr]             Byte in CPU memory (read without side effects)
+//   123 $7b 0x7b       Numbers
+//
+// Operators, loosest first, with C meaning:
+//   ||  &&  |  ^  &  == !=  < <= > >=  << >>  + -  * / %  unary ! ~ -
+class Expression {
+  public:
+    Expression() {}
+
+    // Compiles |text|.  On failure, returns false and describes the
+    // problem in |error|.
+    bool Compile(const std::string& text, std::string* error);
+    int32_t Evaluate(NES* nes, uint16_t addr, uint8_t val) const;
+
+    inline const std::string& text() const { return text_; }
+    inline bool empty() const { return code_.empty(); }
+
+  private:
+    enum Opcode {
+        PUSH,
+        REG_A, REG_X, REG_Y, REG_SP, REG_P, REG_PC,
+        FLAG,           // Bit |arg| of P.
+        ADDR, VAL, BANK, SCANLINE, CYCLE, FRAME,
+        LOAD,
+        NEG, NOT, CPL,
+        MUL, DIV, MOD, ADD, SUB, SHL, SHR,
+        LT, LE, GT, GE, EQ, NE,
+        AND, XOR, OR,
+        JFALSE,         // If top is 0, jump; else pop.
+        JTRUE,          // If top is non-zero, replace with 1 and jump; else pop.
+        BOOL,
+    };
+    struct Op {
+        Opcode op;
+        int32_t arg;
+    };
+    static const int kMaxStack = 32;
+    static const int kLevels = 10;
+
+    // Recursive descent parser; each level handles one precedence.
+    bool Binary(int level);
+    bool Unary();
+    bool Primary();
+    void SkipSpace();
+    bool Match(const char* tok);
+    bool Error(const char* msg);
+    void Emit(Opcode op, int32_t arg=0);
+
+    std::string text_;
+    std::vector<Op> code_;
+
+    // Parser state.
+    const char* p_;
+    std::string* error_;
+    int depth_;
+    int max_depth_;
+};
+
+#endif // EMUDORE_SRC_NES_EXPR_H
@@ -0,0 +1,80 @@
+#ifndef EMUDORE_SRC_NES_FRAME_QUEUE_H
+#define EMUDORE_SRC_NES_FRAME_QUEUE_H
+#include <atomic>
+#include <cstdint>
+
+// Triple-buffered hand-off of finished frames from the PPU to the screen.
+//
+// The PPU renders into back() and calls Publish() at vertical blank, which
+// swaps it with the shared middle buffer.  The presenter calls Acquire(),
+// which swaps the middle buffer out again if it holds a frame it hasn't
+// seen.  Both sides only exchange buffer indices through one atomic, so
+// neither ever waits for or copies from the other.  A frame published over
+// one that was never acquired is dropped; a refresh with nothing new
+// repeats the previous frame.
+class FrameQueue {
+  public:
+    struct Frame {
+        // Palette indices and per-scanline emphasis bits; see PPU.
+        uint8_t picture[256*240];
+        uint8_t emphasis[240];
+        uint64_t number;
+    };
+
+    FrameQueue()
+      : frames_{},
+        back_(0),
+        front_(1),
+        middle_(2),
+        published_(0),
+        dropped_(0),
+        presented_(0),
+        repeated_(0) {}
+
+    // Producer side.
+    inline Frame* back() { return &frames_[back_]; }
+    inline void Publish() {
+        int prev = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel);
+        if (prev & kFresh)
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+        back_ = prev & kIndex;
+        published_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Consumer side.  Returns the newest frame, or nullptr if there is
+    // nothing new since the last call.
+    inline const Frame* Acquire() {
+        if (!(middle_.load(std::memory_order_relaxed) & kFresh))
+            return nullptr;
+        front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndex;
+        presented_++;
+        return &frames_[front_];
+    }
+    // Called when the screen is refreshed without a new frame.  Acquire
+    // can't tell, since the presenter polls it more often than it
+    // refreshes.
+    inline void Repeat() {
+        if (presented_)
+            repeated_++;
+    }
+
+    inline uint64_t published() const { return published_; }
+    inline uint64_t dropped() const { return dropped_; }
+    inline uint64_t presented() const { return presented_; }
+    inline uint64_t repeated() const { return repeated_; }
+
+  private:
+    static const int kIndex = 3;
+    static const int kFresh = 4;
+
+    Frame frames_[3];
+    int back_;
+    int front_;
+    std::atomic<int> middle_;
+    std::atomic<uint64_t> published_;
+    std::atomic<uint64_t> dropped_;
+    uint64_t presented_;
+    uint64_t repeated_;
+};
+
+#endif // EMUDORE_SRC_NES_FRAME_QUEUE_H
@@ -8,19 +8,68 @@
 
 class Mapper {
   public:
-    Mapper(NES* nes) : nes_(nes) {}
+    Mapper(NES* nes)
+      : nes_(nes), expansion_(false), watch_a12_(false), watch_lines_(false),
+        bg_tiles_(false), chr_pages_{nullptr, nullptr, nullptr} {}
     virtual uint8_t Read(uint16_t addr) = 0;
     virtual void ReadChr2(uint16_t addr, uint8_t* a, uint8_t* b) {
         *a = Read(addr);
         *b = Read(addr + 8);
     }
     virtual void Write(uint16_t addr, uint8_t val) = 0;
-    virtual void Emulate() {}
+    // Reads for the debugger: like Read, but without the side effects a
+    // read of a mapper register may have.
+    virtual uint8_t Peek(uint16_t addr) { return Read(addr); }
+    // Returns the PRG ROM offset currently mapped at CPU address addr,
+    // or -1 if addr does not map to PRG ROM.
+    virtual int PrgOffset(uint16_t addr) { return -1; }
+    // Returns the CHR offset currently mapped at PPU address addr,
+    // or -1 if addr does not map to CHR.
+    virtual int ChrOffset(uint16_t addr) { return -1; }
+    // Called for each rising edge of PPU address line A12 that follows a
+    // long enough low period, if the mapper sets watch_a12_.  Edges come
+    // from pattern fetches only, so none arrive while rendering is off.
+    virtual void RiseA12() {}
+    // Called at dot 1 of every line if the mapper sets watch_lines_, with
+    // the scanline while a visible line is being rendered and -1 otherwise.
+    virtual void Scanline(int line) {}
+    // A background tile to fetch in place of the one the PPU's address
+    // register points at: its name table byte, its palette and the CHR
+    // offset of the row to draw.
+    struct BgTile {
+        uint8_t name;
+        uint8_t palette;
+        int chr;
+    };
+    // Called for each background tile fetch if the mapper sets bg_tiles_.
+    // |column| counts the line's 34 fetches from 0 and |line| is the line
+    // they are for; tile->name holds the name table byte the PPU read.
+    // Returns false to fetch the tile as usual.
+    virtual bool FetchBgTile(uint16_t v, int column, int line, BgTile* tile) {
+        return false;
+    }
     virtual void DebugStuff() {}
     virtual void LoadState(proto::Mapper *state) {}
     virtual void SaveState(proto::Mapper *state) {}
+    // True if the mapper also decodes $4020-$5FFF.
+    inline bool expansion() const { return expansion_; }
+    inline bool watch_a12() const { return watch_a12_; }
+    inline bool watch_lines() const { return watch_lines_; }
+    inline bool bg_tiles() const { return bg_tiles_; }
+    // The 1K CHR page offsets pattern fetches use instead of asking
+    // ChrOffset, or nullptr.  While sprites are 8x16, backgrounds and
+    // sprites may have their own pages (MMC5).
+    inline const int* chr_pages(bool sprite, bool tall) const {
+        return chr_pages_[tall ? 1 + sprite : 0];
+    }
   protected:
     NES* nes_;
+    bool expansion_;
+    bool watch_a12_;
+    bool watch_lines_;
+    bool bg_tiles_;
+    // Normal pages, then backgrounds and sprites in 8x16 mode.
+    const int* chr_pages_[3];
 };
 
 class MapperRegistry {
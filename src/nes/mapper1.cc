@@ -64,6 +64,19 @@ uint8_t Mapper1::Read(uint16_t addr) {
     return 0;
 }
 
+int Mapper1::PrgOffset(uint16_t addr) {
+    if (addr < 0x8000)
+        return -1;
+    addr -= 0x8000;
+    return prg_offset_[addr / 0x4000] + addr % 0x4000;
+}
+
+int Mapper1::ChrOffset(uint16_t addr) {
+    if (addr >= 0x2000)
+        return -1;
+    return chr_offset_[addr / 0x1000] + addr % 0x1000;
+}
+
 void Mapper1::ReadChr2(uint16_t addr, uint8_t* a, uint8_t* b) {
     if (addr < 0x2000) {
         int bank = addr / 0x1000;
@@ -89,9 +102,6 @@ void Mapper1::Write(uint16_t addr, uint8_t val) {
     }
 }
 
-void Mapper1::Emulate() {
-}
-
 int Mapper1::PrgBankOffset(int index) {
     if (index >= 0x80)
         index -= 0x100;
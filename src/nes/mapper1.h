@@ -10,7 +10,8 @@ class Mapper1: public Mapper {
     void ReadChr2(uint16_t addr, uint8_t* a, uint8_t* b) override;
     uint8_t Read(uint16_t addr) override;
     void Write(uint16_t addr, uint8_t val) override;
-    void Emulate() override;
+    int PrgOffset(uint16_t addr) override;
+    int ChrOffset(uint16_t addr) override;
     void DebugStuff() override;
 
     void LoadState(proto::Mapper* state) override;
@@ -36,6 +36,17 @@ class Mapper3: public Mapper {
         return 0;
     }
 
+    int PrgOffset(uint16_t addr) override {
+        if (addr < 0x8000)
+            return -1;
+        int bank = (addr < 0xC000) ? prg_bank1_ : prg_bank2_;
+        return bank*0x4000 + (addr & 0x3FFF);
+    }
+
+    int ChrOffset(uint16_t addr) override {
+        return (addr < 0x2000) ? addr : -1;
+    }
+
     void Write(uint16_t addr, uint8_t val) override {
         if (addr < 0x2000) {
             return nes_->cartridge()->WriteChr(addr, val);
@@ -10,7 +10,9 @@ class Mapper4: public Mapper {
     Mapper4(NES* nes);
     uint8_t Read(uint16_t addr) override;
     void Write(uint16_t addr, uint8_t val) override;
-    void Emulate() override;
+    int PrgOffset(uint16_t addr) override;
+    int ChrOffset(uint16_t addr) override;
+    void RiseA12() override;
     void LoadState(proto::Mapper* mstate) override;
     void SaveState(proto::Mapper* mstate) override;
 
@@ -46,6 +48,7 @@ Mapper4::Mapper4(NES* nes)
         prg_offset_[1] = PrgBankOffset(1);
         prg_offset_[2] = PrgBankOffset(-2);
         prg_offset_[3] = PrgBankOffset(-1);
+        watch_a12_ = true;
 }
 
 void Mapper4::LoadState(proto::Mapper* mstate) {
@@ -88,6 +91,19 @@ uint8_t Mapper4::Read(uint16_t addr) {
     return 0;
 }
 
+int Mapper4::PrgOffset(uint16_t addr) {
+    if (addr < 0x8000)
+        return -1;
+    addr -= 0x8000;
+    return prg_offset_[addr / 0x2000] + addr % 0x2000;
+}
+
+int Mapper4::ChrOffset(uint16_t addr) {
+    if (addr >= 0x2000)
+        return -1;
+    return chr_offset_[addr / 0x400] + addr % 0x400;
+}
+
 void Mapper4::Write(uint16_t addr, uint8_t val) {
     if (addr < 0x2000) {
         int bank = addr / 0x400;
@@ -102,20 +118,10 @@ void Mapper4::Write(uint16_t addr, uint8_t val) {
     }
 }
 
-void Mapper4::Emulate() {
-    auto cycle = nes_->ppu()->cycle();
-    auto scanline = nes_->ppu()->scanline();
-    auto mask = nes_->ppu()->mask();
-
-    // fogleman's NES uses 280 here (and comments that it should be 260)
-    // Nimes uses 300.
-    if (cycle != 260)
-        return;
-    if (scanline >= 240 && scanline <= 260)
-        return;
-    if (!mask.showbg and !mask.showsprites)
-        return;
-
+void Mapper4::RiseA12() {
+    // With backgrounds at $0000 and sprites at $1000 this happens at dot
+    // 261 of each rendered line; the other way round, at dot 325 of the
+    // line before.
     if (counter_ == 0) {
         counter_ = reload_;
     } else {
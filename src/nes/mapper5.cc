@@ -0,0 +1,485 @@
+#include <cstdint>
+#include <cstring>
+#include "src/nes/mapper.h"
+#include "src/nes/apu.h"
+#include "src/nes/apu_mmc5.h"
+#include "src/nes/cartridge.h"
+#include "src/nes/mem.h"
+#include "src/pbmacro.h"
+
+// Nintendo MMC5 (ExROM).
+//
+// PRG is banked in 8K windows at $6000-$FFFF, any of which but the last
+// may hold RAM.  The first 8K of RAM is the cartridge's battery-backed RAM;
+// the rest is not saved with it.  CHR has two sets of banks: with 8x16
+// sprites, sprites use $5120-$5127 and backgrounds $5128-$512B, otherwise
+// everything uses the set written last.  The PPU reads both through
+// chr_pages_, and the nametables through Mem's page pointers, so the only
+// per-tile calls are for ExRAM's extended attributes and the vertical split.
+class Mapper5: public Mapper {
+  public:
+    Mapper5(NES* nes);
+    uint8_t Read(uint16_t addr) override;
+    void Write(uint16_t addr, uint8_t val) override;
+    uint8_t Peek(uint16_t addr) override;
+    int PrgOffset(uint16_t addr) override;
+    int ChrOffset(uint16_t addr) override;
+    void Scanline(int line) override;
+    bool FetchBgTile(uint16_t v, int column, int line, BgTile* tile) override;
+    void DebugStuff() override;
+    void LoadState(proto::Mapper* mstate) override;
+    void SaveState(proto::Mapper* mstate) override;
+
+  private:
+    uint8_t ReadRegister(uint16_t addr, bool peek);
+    void WriteRegister(uint16_t addr, uint8_t val);
+    uint8_t ReadPrgWindow(uint16_t addr);
+    void WritePrgWindow(uint16_t addr, uint8_t val);
+    int ChrBankOffset(int bank, int size);
+    void SetPrg(int window, uint8_t bank, bool rom);
+    void UpdatePrg();
+    void UpdateChr();
+    void UpdateNametables();
+    void UpdateFill();
+
+    uint8_t prg_mode_;
+    uint8_t chr_mode_;
+    uint8_t ram_protect_[2];
+    uint8_t exram_mode_;
+    uint8_t nametables_;
+    uint8_t fill_tile_;
+    uint8_t fill_color_;
+    // $5113-$5117 and $5120-$512B, the CHR banks with their upper bits.
+    uint8_t prg_[5];
+    uint16_t chr_[12];
+    uint8_t chr_upper_;
+    bool last_bg_;
+
+    uint8_t split_control_;
+    uint8_t split_scroll_;
+    uint8_t split_bank_;
+
+    uint8_t irq_compare_;
+    bool irq_enabled_;
+    bool irq_pending_;
+    bool in_frame_;
+    uint8_t irq_counter_;
+
+    uint8_t multiplicand_;
+    uint8_t multiplier_;
+
+    // The 8K windows at $6000-$FFFF: an offset into PRG ROM or into RAM.
+    int prg_offset_[5];
+    bool prg_ram_[5];
+    // 1K pages for sprites ($5120-$5127) and backgrounds ($5128-$512B).
+    int chr_sprite_[8];
+    int chr_bg_[8];
+
+    uint8_t exram_[0x400];
+    // Fill mode's nametable, and the one ExRAM reads as when the CPU owns
+    // it.  PPU writes through them are lost on the next update.
+    uint8_t fill_[0x400];
+    uint8_t blank_[0x400];
+    // PRG RAM beyond the first 8K, which is the cartridge's.
+    uint8_t ram_[0x10000];
+
+    Mmc5Audio* audio_;
+};
+
+Mapper5::Mapper5(NES* nes)
+    : Mapper(nes),
+    prg_mode_(3), chr_mode_(0),
+    ram_protect_{0, 0},
+    exram_mode_(0),
+    nametables_(0),
+    fill_tile_(0), fill_color_(0),
+    prg_{0, 0, 0, 0, 0xFF},
+    chr_{0,},
+    chr_upper_(0),
+    last_bg_(false),
+    split_control_(0), split_scroll_(0), split_bank_(0),
+    irq_compare_(0),
+    irq_enabled_(false), irq_pending_(false), in_frame_(false),
+    irq_counter_(0),
+    multiplicand_(0xFF), multiplier_(0xFF),
+    prg_offset_{0,}, prg_ram_{false,},
+    chr_sprite_{0,}, chr_bg_{0,},
+    exram_{0,}, fill_{0,}, blank_{0,}, ram_{0,},
+    audio_(new Mmc5Audio()) {
+        expansion_ = true;
+        watch_lines_ = true;
+        bg_tiles_ = true;
+        chr_pages_[1] = chr_bg_;
+        chr_pages_[2] = chr_sprite_;
+        nes_->apu()->set_expansion(audio_);
+        UpdatePrg();
+        UpdateChr();
+        UpdateNametables();
+}
+
+void Mapper5::LoadState(proto::Mapper* mstate) {
+    auto* state = mstate->mutable_mmc5();
+    LOAD(prg_mode, chr_mode, exram_mode, nametables, fill_tile, fill_color,
+         chr_upper, last_bg, split_control, split_scroll, split_bank,
+         irq_compare, irq_enabled, irq_pending, in_frame, irq_counter,
+         multiplicand, multiplier);
+    for(int i=0; i<2 && i<state->ram_protect_size(); i++)
+        ram_protect_[i] = state->ram_protect(i);
+    for(int i=0; i<5 && i<state->prg_size(); i++)
+        prg_[i] = state->prg(i);
+    for(int i=0; i<12 && i<state->chr_size(); i++)
+        chr_[i] = state->chr(i);
+    const auto& exram = state->exram();
+    memcpy(exram_, exram.data(),
+           exram.size() < sizeof(exram_) ? exram.size() : sizeof(exram_));
+    const auto& ram = state->ram();
+    memcpy(ram_, ram.data(),
+           ram.size() < sizeof(ram_) ? ram.size() : sizeof(ram_));
+    UpdatePrg();
+    UpdateChr();
+    UpdateFill();
+    UpdateNametables();
+}
+
+void Mapper5::SaveState(proto::Mapper* mstate) {
+    auto* state = mstate->mutable_mmc5();
+    SAVE(prg_mode, chr_mode, exram_mode, nametables, fill_tile, fill_color,
+         chr_upper, last_bg, split_control, split_scroll, split_bank,
+         irq_compare, irq_enabled, irq_pending, in_frame, irq_counter,
+         multiplicand, multiplier);
+    state->clear_ram_protect();
+    state->clear_prg();
+    state->clear_chr();
+    for(int i=0; i<2; i++)
+        state->add_ram_protect(ram_protect_[i]);
+    for(int i=0; i<5; i++)
+        state->add_prg(prg_[i]);
+    for(int i=0; i<12; i++)
+        state->add_chr(chr_[i]);
+    state->set_exram((char*)exram_, sizeof(exram_));
+    state->set_ram((char*)ram_, sizeof(ram_));
+}
+
+void Mapper5::DebugStuff() {
+    ImGui::Text("PRG mode %d: %02x %02x %02x %02x %02x", prg_mode_,
+                prg_[0], prg_[1], prg_[2], prg_[3], prg_[4]);
+    ImGui::Text("CHR mode %d, upper %d, last set %c", chr_mode_, chr_upper_,
+                last_bg_ ? 'B' : 'A');
+    ImGui::Text("ExRAM mode %d, nametables %02x, fill %02x/%d", exram_mode_,
+                nametables_, fill_tile_, fill_color_);
+    ImGui::Text("Split %02x scroll %d bank %d", split_control_,
+                split_scroll_, split_bank_);
+    ImGui::Text("IRQ at line %d, %s%s", irq_compare_,
+                irq_enabled_ ? "enabled" : "disabled",
+                irq_pending_ ? ", pending" : "");
+}
+
+uint8_t Mapper5::Read(uint16_t addr) {
+    if (addr < 0x2000) {
+        return nes_->cartridge()->ReadChr(ChrOffset(addr));
+    } else if (addr >= 0x6000) {
+        return ReadPrgWindow(addr);
+    } else if (addr >= 0x5000) {
+        return ReadRegister(addr, false);
+    }
+    return 0;
+}
+
+uint8_t Mapper5::Peek(uint16_t addr) {
+    if (addr >= 0x5000 && addr < 0x6000)
+        return ReadRegister(addr, true);
+    return Read(addr);
+}
+
+void Mapper5::Write(uint16_t addr, uint8_t val) {
+    if (addr < 0x2000) {
+        nes_->cartridge()->WriteChr(ChrOffset(addr), val);
+    } else if (addr >= 0x6000) {
+        WritePrgWindow(addr, val);
+    } else if (addr >= 0x5000) {
+        WriteRegister(addr, val);
+    }
+}
+
+int Mapper5::PrgOffset(uint16_t addr) {
+    if (addr < 0x6000)
+        return -1;
+    int window = (addr - 0x6000) >> 13;
+    if (prg_ram_[window])
+        return -1;
+    return prg_offset_[window] + (addr & 0x1FFF);
+}
+
+int Mapper5::ChrOffset(uint16_t addr) {
+    if (addr >= 0x2000)
+        return -1;
+    return chr_pages_[0][addr >> 10] + (addr & 0x3FF);
+}
+
+uint8_t Mapper5::ReadPrgWindow(uint16_t addr) {
+    int window = (addr - 0x6000) >> 13;
+    int offset = prg_offset_[window] + (addr & 0x1FFF);
+    if (!prg_ram_[window])
+        return nes_->cartridge()->ReadPrg(offset);
+    if (offset < 0x2000)
+        return nes_->cartridge()->ReadSram(offset);
+    return ram_[offset];
+}
+
+void Mapper5::WritePrgWindow(uint16_t addr, uint8_t val) {
+    int window = (addr - 0x6000) >> 13;
+    if (!prg_ram_[window] || ram_protect_[0] != 2 || ram_protect_[1] != 1)
+        return;
+    int offset = prg_offset_[window] + (addr & 0x1FFF);
+    if (offset < 0x2000)
+        nes_->cartridge()->WriteSram(offset, val);
+    else
+        ram_[offset] = val;
+}
+
+// A |peek| leaves the IRQ pending and doesn't run the APU.
+uint8_t Mapper5::ReadRegister(uint16_t addr, bool peek) {
+    if (addr >= 0x5C00)
+        return exram_mode_ >= 2 ? exram_[addr - 0x5C00] : 0;
+    switch(addr) {
+    case 0x5015:
+        return peek ? 0 : nes_->apu()->ReadExpansion(addr);
+    case 0x5204: {
+        uint8_t val = (irq_pending_ ? 0x80 : 0) | (in_frame_ ? 0x40 : 0);
+        if (!peek)
+            irq_pending_ = false;
+        return val;
+    }
+    case 0x5205:
+        return (multiplicand_ * multiplier_) & 0xFF;
+    case 0x5206:
+        return (multiplicand_ * multiplier_) >> 8;
+    default:
+        return 0;
+    }
+}
+
+void Mapper5::WriteRegister(uint16_t addr, uint8_t val) {
+    if (addr >= 0x5C00) {
+        // While ExRAM is a nametable, the CPU can only write it during
+        // rendering, and writes zero otherwise.
+        if (exram_mode_ < 2) {
+            exram_[addr - 0x5C00] = in_frame_ ? val : 0;
+            nes_->memory()->NametablesChanged();
+        } else if (exram_mode_ == 2) {
+            exram_[addr - 0x5C00] = val;
+        }
+        return;
+    }
+    if (addr >= 0x5113 && addr <= 0x5117) {
+        prg_[addr - 0x5113] = val;
+        UpdatePrg();
+        return;
+    }
+    if (addr >= 0x5120 && addr <= 0x512B) {
+        chr_[addr - 0x5120] = val | (chr_upper_ << 8);
+        last_bg_ = addr >= 0x5128;
+        UpdateChr();
+        return;
+    }
+    switch(addr) {
+    case 0x5000: case 0x5002: case 0x5003:
+    case 0x5004: case 0x5006: case 0x5007:
+    case 0x5010: case 0x5011: case 0x5015:
+        nes_->apu()->WriteExpansion(addr, val);
+        break;
+    case 0x5100:
+        prg_mode_ = val & 3;
+        UpdatePrg();
+        break;
+    case 0x5101:
+        chr_mode_ = val & 3;
+        UpdateChr();
+        break;
+    case 0x5102:
+    case 0x5103:
+        ram_protect_[addr - 0x5102] = val & 3;
+        break;
+    case 0x5104:
+        exram_mode_ = val & 3;
+        UpdateNametables();
+        break;
+    case 0x5105:
+        nametables_ = val;
+        UpdateNametables();
+        break;
+    case 0x5106:
+        fill_tile_ = val;
+        UpdateFill();
+        break;
+    case 0x5107:
+        fill_color_ = val & 3;
+        UpdateFill();
+        break;
+    case 0x5130:
+        chr_upper_ = val & 3;
+        break;
+    case 0x5200:
+        split_control_ = val;
+        break;
+    case 0x5201:
+        split_scroll_ = val;
+        break;
+    case 0x5202:
+        split_bank_ = val;
+        break;
+    case 0x5203:
+        irq_compare_ = val;
+        break;
+    case 0x5204:
+        irq_enabled_ = val & 0x80;
+        if (irq_enabled_ && irq_pending_)
+            nes_->IRQ();
+        break;
+    case 0x5205:
+        multiplicand_ = val;
+        break;
+    case 0x5206:
+        multiplier_ = val;
+        break;
+    default:
+        ;
+    }
+}
+
+void Mapper5::Scanline(int line) {
+    if (line < 0) {
+        in_frame_ = false;
+        return;
+    }
+    if (!in_frame_) {
+        in_frame_ = true;
+        irq_counter_ = 0;
+        return;
+    }
+    irq_counter_++;
+    if (irq_counter_ == irq_compare_) {
+        irq_pending_ = true;
+        if (irq_enabled_)
+            nes_->IRQ();
+    }
+}
+
+bool Mapper5::FetchBgTile(uint16_t v, int column, int line, BgTile* tile) {
+    int count = split_control_ & 0x1F;
+    bool right = split_control_ & 0x40;
+    if ((split_control_ & 0x80) && exram_mode_ < 2 && line < 240 &&
+        (right ? column >= count : column < count)) {
+        // The split region is drawn from ExRAM with its own vertical
+        // scroll and 4K CHR bank.
+        int y = (split_scroll_ + line) % 240;
+        int x = column & 31;
+        tile->name = exram_[(y / 8) * 32 + x];
+        uint8_t attr = exram_[0x3C0 + (y / 32) * 8 + x / 4];
+        tile->palette = attr >> (((y >> 2) & 4) | (x & 2));
+        tile->chr = ChrBankOffset(split_bank_, 0x1000) + 16 * tile->name +
+                    (y & 7);
+        return true;
+    }
+    if (exram_mode_ == 1) {
+        // Extended attributes: each tile's ExRAM byte picks its palette
+        // and a 4K CHR bank.
+        uint8_t ex = exram_[v & 0x3FF];
+        tile->palette = ex >> 6;
+        tile->chr = ChrBankOffset((chr_upper_ << 6) | (ex & 0x3F), 0x1000) +
+                    16 * tile->name + ((v >> 12) & 7);
+        return true;
+    }
+    return false;
+}
+
+int Mapper5::ChrBankOffset(int bank, int size) {
+    int len = nes_->cartridge()->chrlen();
+    return (bank * size) % len;
+}
+
+void Mapper5::SetPrg(int window, uint8_t bank, bool rom) {
+    prg_ram_[window] = !rom;
+    if (rom)
+        prg_offset_[window] = ((bank & 0x7F) * 0x2000) %
+                              nes_->cartridge()->prglen();
+    else
+        prg_offset_[window] = (bank & 7) * 0x2000;
+}
+
+void Mapper5::UpdatePrg() {
+    SetPrg(0, prg_[0], false);
+    switch(prg_mode_) {
+    case 0:
+        for(int i=0; i<4; i++)
+            SetPrg(1 + i, (prg_[4] & 0x7C) | i, true);
+        break;
+    case 1:
+        for(int i=0; i<2; i++) {
+            SetPrg(1 + i, (prg_[2] & 0x7E) | i, prg_[2] & 0x80);
+            SetPrg(3 + i, (prg_[4] & 0x7E) | i, true);
+        }
+        break;
+    case 2:
+        for(int i=0; i<2; i++)
+            SetPrg(1 + i, (prg_[2] & 0x7E) | i, prg_[2] & 0x80);
+        SetPrg(3, prg_[3], prg_[3] & 0x80);
+        SetPrg(4, prg_[4], true);
+        break;
+    case 3:
+        for(int i=0; i<3; i++)
+            SetPrg(1 + i, prg_[1 + i], prg_[1 + i] & 0x80);
+        SetPrg(4, prg_[4], true);
+        break;
+    }
+}
+
+void Mapper5::UpdateChr() {
+    for(int i=0; i<8; i++) {
+        int a = 0, b = 0;
+        switch(chr_mode_) {
+        case 0:
+            a = chr_[7] * 8 + i;
+            b = chr_[11] * 8 + i;
+            break;
+        case 1:
+            a = chr_[i < 4 ? 3 : 7] * 4 + (i & 3);
+            b = chr_[11] * 4 + (i & 3);
+            break;
+        case 2:
+            a = chr_[(i & 6) + 1] * 2 + (i & 1);
+            b = chr_[8 + (i & 2) + 1] * 2 + (i & 1);
+            break;
+        case 3:
+            a = chr_[i];
+            b = chr_[8 + (i & 3)];
+            break;
+        }
+        chr_sprite_[i] = ChrBankOffset(a, 0x400);
+        chr_bg_[i] = ChrBankOffset(b, 0x400);
+    }
+    chr_pages_[0] = last_bg_ ? chr_bg_ : chr_sprite_;
+}
+
+void Mapper5::UpdateNametables() {
+    Mem* mem = nes_->memory();
+    for(int slot=0; slot<4; slot++) {
+        switch((nametables_ >> (2 * slot)) & 3) {
+        case 0: mem->set_nametable(slot, mem->ciram(0)); break;
+        case 1: mem->set_nametable(slot, mem->ciram(1)); break;
+        case 2:
+            mem->set_nametable(slot, exram_mode_ < 2 ? exram_ : blank_);
+            break;
+        case 3: mem->set_nametable(slot, fill_); break;
+        }
+    }
+}
+
+void Mapper5::UpdateFill() {
+    memset(fill_, fill_tile_, 0x3C0);
+    memset(fill_ + 0x3C0, fill_color_ * 0x55, 0x40);
+    memset(blank_, 0, sizeof(blank_));
+    nes_->memory()->NametablesChanged();
+}
+
+REGISTER_MAPPER(5, Mapper5);
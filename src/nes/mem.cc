@@ -16,8 +16,14 @@ DEFINE_string(memdump, "", "Custom memory dump textfile.");
 Mem::Mem(NES* nes)
     : Memory(),
     nes_(nes),
+    cdl_(nullptr),
     ram_{0, },
-    ppuram_{0, } {
+    ppuram_{0, },
+    nametable_{nullptr, },
+    palette_version_(0),
+    nametable_version_(0),
+    cheat_page_{false, } {
+    SetMirror(Cartridge::HORIZONTAL);
 }
 
 void Mem::LoadState(proto::NES* state) {
@@ -30,6 +36,8 @@ void Mem::LoadState(proto::NES* state) {
            ppuram.size() <= sizeof(ppuram_) ? ppuram.size() : sizeof(ppuram_));
     memcpy(palette_, palette.data(),
            palette.size() <= sizeof(palette_) ? palette.size() : sizeof(palette_));
+    palette_version_++;
+    nametable_version_++;
 }
 
 void Mem::SaveState(proto::NES* state) {
@@ -42,7 +50,59 @@ void Mem::SaveState(proto::NES* state) {
     palette->assign((char*)palette_, sizeof(palette_));
 }
 
+// Cheats on RAM are kept by their address in the first 2K, so they apply
+// through all four mirrors.
+static uint16_t CheatAddr(uint16_t addr) {
+    return addr < 0x2000 ? addr & 0x7FF : addr;
+}
+
+void Mem::SetCheatPage(uint16_t addr, bool on) {
+    if (addr < 0x800) {
+        for(int m=0; m<4; m++)
+            cheat_page_[(addr >> 8) + m * 8] = on;
+    } else {
+        cheat_page_[addr >> 8] = on;
+    }
+}
+
+void Mem::AddCheat(uint16_t addr, uint8_t val, int compare) {
+    addr = CheatAddr(addr);
+    cheats_[addr] = Cheat{val, compare};
+    SetCheatPage(addr, true);
+}
+
+void Mem::RemoveCheat(uint16_t addr) {
+    addr = CheatAddr(addr);
+    cheats_.erase(addr);
+    auto it = cheats_.lower_bound(addr & 0xFF00);
+    SetCheatPage(addr, it != cheats_.end() && (it->first >> 8) == (addr >> 8));
+}
+
+uint8_t Mem::CheatRead(uint16_t addr, uint8_t val) {
+    auto it = cheats_.find(CheatAddr(addr));
+    if (it == cheats_.end())
+        return val;
+    const Cheat& c = it->second;
+    if (c.compare != -1 && c.compare != val)
+        return val;
+    return c.val;
+}
+
 uint8_t Mem::read_byte(uint16_t addr) {
+    uint8_t val = ReadBus(addr);
+    if (cheat_page_[addr >> 8])
+        val = CheatRead(addr, val);
+    return val;
+}
+
+uint8_t Mem::read_byte_no_io(uint16_t addr) {
+    uint8_t val = ReadBusNoIO(addr);
+    if (cheat_page_[addr >> 8])
+        val = CheatRead(addr, val);
+    return val;
+}
+
+uint8_t Mem::ReadBus(uint16_t addr) {
     if (addr < 0x2000) {
         return ram_[addr];
     } else if (addr < 0x4000 || addr == 0x4014) {
@@ -54,6 +114,10 @@ uint8_t Mem::read_byte(uint16_t addr) {
     } else if (addr == 0x4017) {
         return nes_->controller(1)->Read();
     } else if (addr >= 0x6000) {
+        if (cdl_)
+            cdl_->LogPrg(nes_->mapper()->PrgOffset(addr), addr);
+        return nes_->mapper()->Read(addr);
+    } else if (addr >= 0x4020 && nes_->mapper()->expansion()) {
         return nes_->mapper()->Read(addr);
     } else {
         fprintf(stderr, "Unknown read at %04x\n", addr);
@@ -61,17 +125,24 @@ uint8_t Mem::read_byte(uint16_t addr) {
     return 0;
 }
 
-uint8_t Mem::read_byte_no_io(uint16_t addr) {
+uint8_t Mem::ReadBusNoIO(uint16_t addr) {
     if (addr < 0x2000) {
         return ram_[addr];
     } else if (addr >= 0x6000) {
-        return nes_->mapper()->Read(addr);
-    } else {
+        return nes_->mapper()->Peek(addr);
+    } else if (addr >= 0x4020 && nes_->mapper()->expansion()) {
+        return nes_->mapper()->Peek(addr);
     }
     return 0;
 }
 
 void Mem::write_byte(uint16_t addr, uint8_t v) {
+    // Nailed RAM and SRAM ignore writes.  Cheats anywhere else must not
+    // block writes to the registers behind them.
+    if (cheat_page_[addr >> 8] &&
+        (addr < 0x2000 || (addr >= 0x6000 && addr < 0x8000)) &&
+        cheats_.count(CheatAddr(addr)))
+        return;
     if (addr < 0x2000) {
         ram_[addr] = v;
     } else if (addr < 0x4000 || addr == 0x4014) {
@@ -81,7 +152,8 @@ void Mem::write_byte(uint16_t addr, uint8_t v) {
         return nes_->controller(1)->Write(v);
     } else if (addr >= 0x4000 && addr <= 0x4017) {
         nes_->apu()->Write(addr, v);
-    } else if (addr >= 0x6000) {
+    } else if (addr >= 0x6000 ||
+               (addr >= 0x4020 && nes_->mapper()->expansion())) {
         nes_->mapper()->Write(addr, v);
     } else {
         fprintf(stderr, "Unknown write at %04x\n", addr);
@@ -105,27 +177,37 @@ void Mem::write_word(uint16_t addr, uint16_t v) {
 void Mem::write_word_no_io(uint16_t addr, uint16_t v) {
 }
 
-uint16_t Mem::MirrorAddress(int mode, uint16_t addr) {
-    static const uint16_t lookup[5][4] = {
+void Mem::SetMirror(int mode) {
+    static const uint8_t lookup[5][4] = {
         { 0, 0, 1, 1, },
-        { 0, 1, 1, 0, },
+        { 0, 1, 0, 1, },
         { 0, 0, 0, 0, },
         { 1, 1, 1, 1, },
         { 0, 1, 2, 3, },
     };
-    addr = (addr - 0x2000) % 0x1000;
-    int table = addr / 0x400;
-    int offset = addr % 0x400;
-    return lookup[mode][table] * 0x400 + offset + 0x2000;
+    uint8_t* vram = nes_->cartridge()->vram();
+    for(int slot=0; slot<4; slot++) {
+        int page = lookup[mode][slot];
+        set_nametable(slot, page < 2 ? ppuram_ + page * 0x400
+                                     : vram + (page - 2) * 0x400);
+    }
+}
+
+void Mem::set_nametable(int slot, uint8_t* page) {
+    if (nametable_[slot] != page) {
+        nametable_[slot] = page;
+        nametable_version_++;
+    }
 }
 
 uint8_t Mem::PPURead(uint16_t addr) {
     addr %= 0x4000;
     if (addr < 0x2000) {
+        if (cdl_)
+            cdl_->LogChr(nes_->mapper()->ChrOffset(addr), CodeDataLogger::READ);
         return nes_->mapper()->Read(addr);
     } else if (addr < 0x3F00) {
-        int mode = int(nes_->cartridge()->mirror());
-        return ppuram_[MirrorAddress(mode, addr) % 2048];
+        return nametable_[(addr >> 10) & 3][addr & 0x3FF];
     } else {
         return PaletteRead(addr % 32);
     }
@@ -136,8 +218,8 @@ void Mem::PPUWrite(uint16_t addr, uint8_t val) {
     if (addr < 0x2000) {
         nes_->mapper()->Write(addr, val);
     } else if (addr < 0x3F00) {
-        int mode = int(nes_->cartridge()->mirror());
-        ppuram_[MirrorAddress(mode, addr) % 2048] = val;
+        nametable_[(addr >> 10) & 3][addr & 0x3FF] = val;
+        nametable_version_++;
     } else {
         PaletteWrite(addr % 32, val);
     }
@@ -146,33 +228,33 @@ void Mem::PPUWrite(uint16_t addr, uint8_t val) {
 void Mem::HexDump(int addr, int len) {
     static const char hex[] = "0123456789abcdef";
     char line[80];
-    char *b = line;
-    int i, c=55;
+    char *b;
+    int c;
     uint8_t val;
 
-    for(i=0; i < len; i++) {
-        uint16_t a = addr + i;
-        val = read_byte_no_io(a);
-        if (i % 16 == 0) {
-            if (i) {
-                line[c] = '\0';
-                ImGui::Text("%s", line);
-            }
-            memset(line, 32, sizeof(line));
-            b = line; c = 55;
-            *b++ = hex[(a>>12) & 0xf];
-            *b++ = hex[(a>>8) & 0xf];
-            *b++ = hex[(a>>4) & 0xf];
-            *b++ = hex[(a>>0) & 0xf];
-            *b++ = ':';
+    // Only format the lines that are visible.
+    ImGuiListClipper clipper((len + 15) / 16,
+                             ImGui::GetTextLineHeightWithSpacing());
+    for(int n=clipper.DisplayStart; n<clipper.DisplayEnd; n++) {
+        memset(line, 32, sizeof(line));
+        b = line; c = 55;
+        uint16_t a = addr + n * 16;
+        *b++ = hex[(a>>12) & 0xf];
+        *b++ = hex[(a>>8) & 0xf];
+        *b++ = hex[(a>>4) & 0xf];
+        *b++ = hex[(a>>0) & 0xf];
+        *b++ = ':';
+        for(int i=n*16; i < len && i < n*16 + 16; i++) {
+            val = read_byte_no_io(addr + i);
+            b++;
+            *b++ = hex[(val>>4) & 0xf];
+            *b++ = hex[(val>>0) & 0xf];
+            line[c++] = (val>=32 && val<127) ? val : '.';
         }
-        b++;
-        *b++ = hex[(val>>4) & 0xf];
-        *b++ = hex[(val>>0) & 0xf];
-        line[c++] = (val>=32 && val<127) ? val : '.';
+        line[c] = '\0';
+        ImGui::Text("%s", line);
     }
-    line[c] = '\0';
-    ImGui::Text("%s", line);
+    clipper.End();
 }
 
 bool Mem::ReadMemDump() {
@@ -247,6 +329,8 @@ void Mem::DebugStuff() {
     }
 
 
+    if (display_hexdump || display_memdump)
+        nes_->Live();
     if (display_hexdump) {
         ImGui::Begin("Memory Hexdump", &display_hexdump);
         ImGui::Text("----- NES RAM -----");
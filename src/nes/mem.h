@@ -1,13 +1,15 @@
 #ifndef EMUDORE_SRC_NES_MEM_H
 #define EMUDORE_SRC_NES_MEM_H
+#include <map>
 #include <string>
 #include <vector>
 
 #include "proto/nes.pb.h"
 #include "src/memory.h"
+#include "src/nes/cdl.h"
 #include "src/nes/nes.h"
 
-class Mem: public Memory {
+class Mem final : public Memory {
   public:
     Mem(NES* nes);
 
@@ -23,10 +25,51 @@ class Mem: public Memory {
     void write_word(uint16_t addr, uint16_t v) override;
     void write_word_no_io(uint16_t addr, uint16_t v) override;
 
+    // Cheats substitute the value read from an address, optionally only
+    // when the real value equals |compare| (8-letter Game Genie codes).
+    // Cheats on RAM also apply to its mirrors.  Writes to nailed RAM and
+    // SRAM are dropped.  Only pages holding a cheat pay for the lookup.
+    struct Cheat {
+        uint8_t val;
+        int compare;
+    };
+    void AddCheat(uint16_t addr, uint8_t val, int compare=-1);
+    void RemoveCheat(uint16_t addr);
+    inline const std::map<uint16_t, Cheat>& cheats() const { return cheats_; }
+
+    inline void set_cdl(CodeDataLogger* cdl) { cdl_ = cdl; }
+    inline void access_hint(uint8_t kind) {
+        static const uint8_t flags[] = {
+            CodeDataLogger::CODE,
+            CodeDataLogger::CODE | CodeDataLogger::INDIRECT_CODE,
+            CodeDataLogger::DATA,
+            CodeDataLogger::DATA | CodeDataLogger::INDIRECT_DATA,
+        };
+        if (cdl_) cdl_->set_access(flags[kind]);
+    }
+
+    // DMC sample fetches.  The CPU sets its own hint before its next read.
+    inline uint8_t ReadPcm(uint16_t addr) {
+        if (cdl_) cdl_->set_access(CodeDataLogger::PCM);
+        return read_byte(addr);
+    }
+
     uint8_t PPURead(uint16_t addr);
     void PPUWrite(uint16_t addr, uint8_t val);
     void DebugStuff();
 
+    // The four 1K nametables at $2000-$2FFF ($3000-$3EFF mirrors them).
+    // SetMirror points them into the console's 2K of VRAM, or cartridge
+    // VRAM for four-screen boards, for a Cartridge::MirrorMode.  Mappers
+    // that control nametables directly may point a slot at any 1K page.
+    void SetMirror(int mode);
+    void set_nametable(int slot, uint8_t* page);
+    inline uint8_t* nametable(int slot) { return nametable_[slot]; }
+    // One of the two 1K pages of the console's own VRAM.
+    inline uint8_t* ciram(int page) { return ppuram_ + 0x400 * (page & 1); }
+    // For mappers that change a page mapped as a nametable themselves.
+    inline void NametablesChanged() { nametable_version_++; }
+
 
     inline uint8_t PaletteRead(uint16_t addr) {
         if (addr >= 16 && (addr % 4) == 0)
@@ -38,22 +81,37 @@ class Mem: public Memory {
         if (addr >= 16 && (addr % 4) == 0)
             addr -= 16;
         palette_[addr] = val;
+        palette_version_++;
     }
 
+    // Bumped on every write, so debug views can skip unchanged redraws.
+    inline uint32_t palette_version() const { return palette_version_; }
+    inline uint32_t nametable_version() const { return nametable_version_; }
+
     void LoadState(proto::NES* state);
     void SaveState(proto::NES* state);
 
 
   private:
-    uint16_t MirrorAddress(int mode, uint16_t addr);
+    uint8_t ReadBus(uint16_t addr);
+    uint8_t ReadBusNoIO(uint16_t addr);
+    uint8_t CheatRead(uint16_t addr, uint8_t val);
+    void SetCheatPage(uint16_t addr, bool on);
     void HexDump(int addr, int len);
     bool ReadMemDump();
     void MemDump();
 
     NES* nes_;
+    CodeDataLogger* cdl_;
     uint8_t ram_[2048];
     uint8_t ppuram_[2048];
+    uint8_t* nametable_[4];
     uint8_t palette_[32];
+    uint32_t palette_version_;
+    uint32_t nametable_version_;
+
+    std::map<uint16_t, Cheat> cheats_;
+    bool cheat_page_[256];
 
     std::vector<std::string> custom_memdump_;
 };
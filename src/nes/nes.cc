@@ -9,17 +9,42 @@
 #include "src/cpu2.h"
 #include "src/io.h"
 #include "src/nes/apu.h"
+#include "src/nes/breakpoints.h"
 #include "src/nes/cartridge.h"
+#include "src/nes/cdl.h"
 #include "src/nes/controller.h"
 #include "src/nes/debug_console.h"
+#include "src/nes/disasm.h"
 #include "src/nes/fm2.h"
+#include "src/nes/frame_queue.h"
 #include "src/nes/mapper.h"
 #include "src/nes/mem.h"
+#include "src/nes/nsf.h"
+#include "src/nes/ntsc.h"
 #include "src/nes/ppu.h"
+#include "src/nes/profiler.h"
+#include "src/nes/recorder.h"
+#include "src/nes/tracer.h"
 #include "src/sdlutil/gfx.h"
 
+DEFINE_string(capture_audio, "", "Capture audio as WAV to this file, or to "
+              "a command if it starts with '|'.");
+DEFINE_string(capture_video, "", "Capture video to this file, or to a "
+              "command if it starts with '|'.  Raw RGB24, or Y4M if the name "
+              "ends in .y4m.");
+DEFINE_string(cdl, "", "Code/Data log file.  Merged on load, saved on exit.");
 DEFINE_string(fm2, "", "FM2 Movie file.");
 DEFINE_double(fps, 60.0988, "Desired NES fps.");
+DEFINE_bool(ntsc, false, "Apply the NTSC composite video filter.");
+DEFINE_double(nsf_seconds, 150, "Length of each track rendered by --nsf_wav.");
+DEFINE_string(nsf_wav, "", "Render an NSF file to this WAV file and exit, "
+              "rather than playing it.  A name containing %d renders every "
+              "track.");
+DEFINE_int32(speed, 1, "Emulation speed as a multiple of real time.  "
+             "0 runs as fast as possible.");
+DEFINE_int32(turbo, 4, "Speed toggled by the turbo key (Tab).");
+DEFINE_string(trace_file, "", "Stream an instruction trace to this file.  "
+              "Names ending in .gz or .zst are compressed.");
 
 using namespace std::placeholders;
 
@@ -43,34 +68,69 @@ const uint32_t standard_palette[] = {
 };
 
 NES::NES() :
+    palette_version_(0),
     pause_(false),
     step_(false),
     debug_(false),
     reset_(false),
     stall_(0),
-    frame_(0)
+    frame_(0),
+    speed_(1),
+    drawn_at_(0),
+    quit_(false),
+    suspend_(false),
+    suspended_(false),
+    live_(false),
+    unassemble_addr_(0),
+    unassemble_line_(-1)
 {
     cpu_ = new Cpu();
     cart_ = new Cartridge(this);
+    cdl_ = new CodeDataLogger(this);
     controller_[0] = new Controller(this, 0);
     controller_[1] = new Controller(this, 1);
     controller_[2] = new Controller(this, 2);
     controller_[3] = new Controller(this, 3);
     apu_ = new APU(this);
+    breakpoints_ = new Breakpoints(this);
     mapper_ = nullptr;
     mem_ = new Mem(this);
+    nsf_ = nullptr;
     movie_ = new FM2Movie(this);
+    frames_ = new FrameQueue();
+    ntsc_ = new NtscFilter();
+    ntsc_->set_enabled(FLAGS_ntsc);
     ppu_ = new PPU(this);
-    io_ = new IO(256, 240, FLAGS_fps);
-
-    io_->init_audio(44100, 1, APU::BUFFERLEN/2, AUDIO_F32,
-            [this](uint8_t* stream, int len) {
-                apu_->PlayBuffer(stream, len); });
-    io_->init_controllers(
-            [this](SDL_Event* event) { controller_[0]->set_buttons(event); });
-    io_->set_refresh_callback([this](SDL_Renderer* r) { DebugStuff(r); });
-    io_->set_keyboard_callback(
-            [this](SDL_Event* event) { HandleKeyboard(event); });
+    profiler_ = new Profiler(this);
+    disasm_ = new Disassembly(this);
+    tracer_ = new Tracer(this);
+    recorder_ = new Recorder(this);
+    set_speed(FLAGS_speed);
+
+    // Rendering an NSF to WAV needs no window or audio device.
+    io_ = nullptr;
+    if (FLAGS_nsf_wav.empty()) {
+        io_ = new IO(256, 240, FLAGS_fps);
+        io_->init_audio(44100, 1, APU::BUFFERLEN/2, AUDIO_F32,
+                [this](uint8_t* stream, int len) {
+                    apu_->PlayBuffer(stream, len); });
+        io_->init_controllers(
+                [this](SDL_Event* event) { input_.Push({false, *event}); });
+        io_->set_refresh_callback([this](SDL_Renderer* r) {
+                DebugStuff(r);
+                if (live_) {
+                    live_ = false;
+                    Resume();
+                }
+        });
+        io_->set_keyboard_callback([this](SDL_Event* event) {
+                // Tab is also text completion in the debug console.
+                if (event->key.keysym.scancode == SDL_SCANCODE_TAB &&
+                    ImGui::GetIO().WantCaptureKeyboard)
+                    return;
+                input_.Push({true, *event});
+        });
+    }
 #if 0
     debugger_ = new Debugger();
     debugger_->cpu(cpu_);
@@ -82,17 +142,7 @@ NES::NES() :
                       ((standard_palette[i] >> 16 ) & 0xFF) |
                       ((standard_palette[i] & 0xFF) << 16);
     }
-    cpu_->set_write_cb(std::bind(&NES::Watcher, this,
-        "PC=%04x wrote %02x to %04x.  A=%02x X=%02x Y=%02x SP=%04x[%04x]",
-        &watches_, _1, _2, _3));
-
-    cpu_->set_exec_cb(std::bind(&NES::Watcher, this,
-        "PC=%04x Exec %02x, inst=%02x.  A=%02x X=%02x Y=%02x SP=%04x[%04x]",
-        &xwatches_, _1, _2, _3));
-    cpu_->set_read_cb(std::bind(&NES::Watcher, this,
-        "PC=%04x Exec %02x, inst=%02x.  A=%02x X=%02x Y=%02x SP=%04x[%04x]",
-        &rwatches_, _1, _2, _3));
-
+    BuildPaletteTables();
     console_.RegisterCommand("db", "Hexdump bytes", [=](int argc, char **argv){
         this->HexdumpBytes(argc, argv);
     });
@@ -126,6 +176,9 @@ NES::NES() :
     console_.RegisterCommand("unnail", "Cancel a nailed byte", [=](int argc, char **argv){
         this->UnnailByte(argc, argv);
     });
+    console_.RegisterCommand("cheat", "Game Genie or PAR code", [=](int argc, char **argv){
+        this->CheatCode(argc, argv);
+    });
     console_.RegisterCommand("mm", "Print mirror mode", [=](int argc, char **argv){
         console_.AddLog("mirror: %d", this->cart_->mirror());
     });
@@ -150,21 +203,72 @@ NES::NES() :
     console_.RegisterCommand("ss", "Save State", [=](int argc, char **argv){
         this->CmdSaveState(argc, argv);
     });
-    console_.RegisterCommand("setw", "Set a write watch", std::bind(&NES::SetWatch, this, _1, _2));
-    console_.RegisterCommand("delw", "Del a write watch", std::bind(&NES::DelWatch, this, _1, _2));
-
-    console_.RegisterCommand("setwx", "Set an exec watch", std::bind(&NES::SetWatch, this, _1, _2));
-    console_.RegisterCommand("delwx", "Del an exec watch", std::bind(&NES::DelWatch, this, _1, _2));
-    console_.RegisterCommand("setwr", "Set an read watch", std::bind(&NES::SetWatch, this, _1, _2));
-    console_.RegisterCommand("delwr", "Del an read watch", std::bind(&NES::DelWatch, this, _1, _2));
+    console_.RegisterCommand("cdl", "Code/Data logger", [=](int argc, char **argv){
+        cdl_->Command(argc, argv);
+    });
+    console_.RegisterCommand("prof", "CPU profiler", [=](int argc, char **argv){
+        profiler_->Command(argc, argv);
+    });
+    console_.RegisterCommand("trace", "Stream an instruction trace", [=](int argc, char **argv){
+        tracer_->Command(argc, argv);
+    });
+    console_.RegisterCommand("capture", "Capture video or audio", [=](int argc, char **argv){
+        recorder_->Command(argc, argv);
+    });
+    console_.RegisterCommand("dis", "Disassembly database", [=](int argc, char **argv){
+        disasm_->Command(argc, argv);
+    });
+    console_.RegisterCommand("setw", "Set a write watch", [=](int argc, char **argv){
+        breakpoints_->SetCommand(argc, argv);
+    });
+    console_.RegisterCommand("delw", "Del a write watch", [=](int argc, char **argv){
+        breakpoints_->DelCommand(argc, argv);
+    });
+    console_.RegisterCommand("setwx", "Set an exec watch", [=](int argc, char **argv){
+        breakpoints_->SetCommand(argc, argv);
+    });
+    console_.RegisterCommand("delwx", "Del an exec watch", [=](int argc, char **argv){
+        breakpoints_->DelCommand(argc, argv);
+    });
+    console_.RegisterCommand("setwr", "Set a read watch", [=](int argc, char **argv){
+        breakpoints_->SetCommand(argc, argv);
+    });
+    console_.RegisterCommand("delwr", "Del a read watch", [=](int argc, char **argv){
+        breakpoints_->DelCommand(argc, argv);
+    });
 }
 
 void NES::LoadFile(const std::string& filename) {
-    cart_->LoadFile(filename);
-    mapper_ = MapperRegistry::New(this, cart_->mapper());
+    if (Cartridge::IsNsf(filename)) {
+        cart_->LoadNsf(filename);
+        nsf_ = new NsfPlayer(this);
+        mapper_ = nsf_->mapper();
+    } else {
+        cart_->LoadFile(filename);
+        mapper_ = MapperRegistry::New(this, cart_->mapper());
+    }
     if (!FLAGS_fm2.empty()) {
         movie_->Load(FLAGS_fm2);
     }
+    if (!FLAGS_cdl.empty()) {
+        cdl_->Load(FLAGS_cdl);
+        cdl_->Start();
+    }
+    disasm_->Reset();
+    disasm_->SeedFromCdl();
+    if (!FLAGS_trace_file.empty()) {
+        tracer_->Start(FLAGS_trace_file);
+    }
+    if (!FLAGS_capture_video.empty() &&
+        !recorder_->StartVideo(FLAGS_capture_video)) {
+        fprintf(stderr, "Could not capture video to %s\n",
+                FLAGS_capture_video.c_str());
+    }
+    if (!FLAGS_capture_audio.empty() &&
+        !recorder_->StartAudio(FLAGS_capture_audio)) {
+        fprintf(stderr, "Could not capture audio to %s\n",
+                FLAGS_capture_audio.c_str());
+    }
 }
 
 void NES::CmdLoadState(int argc, char **argv) {
@@ -243,6 +347,25 @@ void NES::SaveState(const std::string& filename, bool text) {
     }
 }
 
+void NES::BuildPaletteTables() {
+    // Emphasis bits 0, 1 and 2 (red, green, blue) darken the other two
+    // color components.  Host pixels are 0xAABBGGRR.
+    static const double kAttenuate = 0.75;
+    for(int e=0; e<8; e++) {
+        for(int i=0; i<64; i++) {
+            uint32_t pixel = palette_[i] & 0xFF000000;
+            for(int c=0; c<3; c++) {
+                double val = (palette_[i] >> (c * 8)) & 0xFF;
+                if (e && !(e & (1 << c)))
+                    val *= kAttenuate;
+                pixel |= uint32_t(val) << (c * 8);
+            }
+            emphasized_[e][i] = pixel;
+        }
+    }
+    palette_version_++;
+}
+
 void NES::DebugPalette(bool* active) {
     int i, x, y;;
     static ImVec4 pal[64];
@@ -251,6 +374,8 @@ void NES::DebugPalette(bool* active) {
 
     if (!*active)
         return;
+    // The recorder reads the palette on the emulator thread.
+    Live();
 
     if (!once) {
         for(i=0; i<64; i++) {
@@ -288,6 +413,7 @@ void NES::DebugPalette(bool* active) {
                     int(255*pal[i].z)<<16 |
                     int(255*pal[i].y)<<8 |
                     int(255*pal[i].x) ;
+                BuildPaletteTables();
             }
 
         }
@@ -296,24 +422,77 @@ void NES::DebugPalette(bool* active) {
     ImGui::End();
 }
 
-void NES::DebugStuff(SDL_Renderer* r) {
-    static bool palette_editor, debug_console;
+bool NES::Present() {
+    const FrameQueue::Frame* frame = frames_->Acquire();
+    if (ntsc_->enabled()) {
+        if (frame)
+            ntsc_->Submit(frame->picture, frame->emphasis, frame->number % 3);
+        ntsc_->Present(io_);
+        return frame != nullptr;
+    }
+    if (!frame)
+        return false;
+    // Convert straight into the screen's frame.
+    uint32_t* screen = io_->screen_frame(256, 240);
+    for(int y=0; y<240; y++) {
+        const uint32_t* palette = palette_table(frame->emphasis[y]);
+        const uint8_t* src = &frame->picture[y * 256];
+        uint32_t* dst = &screen[y * 256];
+        for(int x=0; x<256; x++)
+            dst[x] = palette[src[x]];
+    }
+    return true;
+}
 
-    ImGui::Text("Frame: %d", int(ppu_->frame()));
+void NES::DebugStuff(SDL_Renderer* r) {
+    static bool palette_editor, debug_console, profiler, disassembly, ntsc;
+
+    ImGui::Text("Frame: %d", int(frames_->published()));
+    ImGui::Text("Presented: %d, dropped %d, repeated %d",
+                int(frames_->presented()), int(frames_->dropped()),
+                int(frames_->repeated()));
+    static const int speeds[] = {1, 2, 4, 8, 0};
+    static const char names[] = "1x\0" "2x\0" "4x\0" "8x\0" "Unlimited\0";
+    std::string items(names, sizeof(names) - 1);
+    int speed = speed_;
+    int sel = 0;
+    while(sel < 5 && speeds[sel] != speed)
+        sel++;
+    if (sel == 5) {
+        // Some other --turbo speed; it's listed only while it's in use.
+        items += std::to_string(speed) + "x";
+        items += '\0';
+    }
+    if (ImGui::Combo("Speed", &sel, items.c_str()) && sel < 5) {
+        Live();
+        set_speed(speeds[sel]);
+    }
     if (ImGui::BeginMenuBar()) {
         if (ImGui::BeginMenu("Console")) {
             ImGui::MenuItem("Palette Editor", nullptr, &palette_editor);
             ImGui::MenuItem("Debug Console", nullptr, &debug_console);
+            ImGui::MenuItem("Profiler", nullptr, &profiler);
+            ImGui::MenuItem("Disassembly", nullptr, &disassembly);
+            ImGui::MenuItem("NTSC Filter", nullptr, &ntsc);
             ImGui::EndMenu();
         }
         ImGui::EndMenuBar();
     }
 
     DebugPalette(&palette_editor);
+    profiler_->DebugStuff(&profiler);
+    disasm_->DebugStuff(&disassembly);
+    ntsc_->DebugStuff(&ntsc);
     if (debug_console) {
+        // Commands run from here.
+        Live();
         console_.Draw("Debug Console", &debug_console);
     }
     mem_->DebugStuff();
+    if (nsf_) {
+        Live();
+        nsf_->DebugStuff();
+    }
     apu_->DebugStuff();
     ppu_->DebugStuff();
     controller_[0]->DebugStuff();
@@ -336,6 +515,9 @@ void NES::HandleKeyboard(SDL_Event *event) {
         case SDL_SCANCODE_F11:
             Reset();
             break;
+        case SDL_SCANCODE_TAB:
+            set_speed(speed_ == 1 ? FLAGS_turbo : 1);
+            break;
         default:
             ;
         }
@@ -347,6 +529,10 @@ int NES::cpu_cycles() {
 }
 
 void NES::Reset() {
+    if (nsf_) {
+        nsf_->Start(nsf_->track());
+        return;
+    }
     cpu_->reset();
     ppu_->Reset();
 }
@@ -357,66 +543,158 @@ bool NES::Emulate() {
         return false;
 #endif
 
+    tracer_->Capture();
     const int n = cpu_->Emulate();
+    tracer_->Commit();
+    profiler_->Step(n);
     for(int i=0; i<n*3; i++) {
         // The PPU is clocked at 3 dots per CPU clock
         ppu_->Emulate();
-        mapper_->Emulate();
         cart_->Emulate();
     }
-    for(int i=0; i<n; i++) {
-        apu_->Emulate();
-    }
+    apu_->Emulate(n);
     return true;
 }
 
+void NES::set_speed(int speed) {
+    speed_ = speed;
+    apu_->set_speed(speed);
+}
+
+bool NES::SkipFrame() {
+    // A capture gets every frame, whatever the speed.
+    if (speed_ == 1 || recorder_->video())
+        return false;
+    if (speed_ > 1)
+        return frame_ % speed_ != 0;
+    // Unlimited: draw a frame whenever the screen could show a new one.
+    uint64_t now = io_->clock_nanos();
+    if (now - drawn_at_ < uint64_t(1e9 / FLAGS_fps))
+        return true;
+    drawn_at_ = now;
+    return false;
+}
+
 bool NES::EmulateFrame() {
+    if (nsf_) {
+        // Only the CPU and APU run; the screen keeps its last frame.
+        nsf_->EmulateFrame();
+        return true;
+    }
     frame_ = ppu_->frame();
+    ppu_->set_skip(SkipFrame());
 
     movie_->Emulate(frame_);
     while(frame_ == ppu_->frame()) {
-        for(const auto& n : nailed_)
-            mem_->Write(n.first, n.second);
-
         if (!Emulate())
             return false;
     }
+    if (cdl_->running() && frame_ % 128 == 0)
+        disasm_->SeedFromCdl();
+    if (disasm_->busy())
+        disasm_->Step();
     return true;
 }
 
-void NES::Run() {
-#if 0
-    uint64_t t0, t1;
-    int64_t ns;
+void NES::EmulatorThread() {
+    InputEvent input;
+    while(!quit_) {
+        Checkpoint();
+        while(input_.Pop(&input)) {
+            if (input.keyboard)
+                HandleKeyboard(&input.event);
+            else
+                controller_[0]->set_buttons(&input.event);
+        }
+        if (pause_) {
+            if (!step_) {
+                sleep_nanos(1000000);
+                continue;
+            }
+            step_ = false;
+        }
+        // The emulator is paced by the audio device, which blocks the
+        // APU when its buffer is full.
+        EmulateFrame();
+    }
+}
 
-    t0 = io_->clock_nanos();
-#endif
+void NES::Checkpoint() {
+    std::unique_lock<std::mutex> lock(sync_mutex_);
+    if (!suspend_)
+        return;
+    suspended_ = true;
+    sync_cv_.notify_all();
+    sync_cv_.wait(lock, [this]{ return !suspend_; });
+    suspended_ = false;
+}
+
+void NES::Suspend() {
+    if (!emulator_.joinable())
+        return;
+    std::unique_lock<std::mutex> lock(sync_mutex_);
+    suspend_ = true;
+    sync_cv_.wait(lock, [this]{ return suspended_; });
+    // Let audio synthesis go idle too, so its state can be looked at.
+    apu_->Drain();
+}
+
+void NES::Live() {
+    if (live_)
+        return;
+    live_ = true;
+    Suspend();
+}
+
+void NES::Resume() {
+    {
+        std::lock_guard<std::mutex> lock(sync_mutex_);
+        suspend_ = false;
+    }
+    sync_cv_.notify_all();
+}
+
+void NES::Run() {
+    const uint64_t interval = uint64_t(1e9 / FLAGS_fps);
+    uint64_t refreshed = 0;
 
     Reset();
+    if (!io_) {
+        if (nsf_)
+            nsf_->Render(FLAGS_nsf_wav, FLAGS_nsf_seconds);
+        else
+            fprintf(stderr, "--nsf_wav needs an NSF file.\n");
+        recorder_->Stop();
+        return;
+    }
+    quit_ = false;
+    emulator_ = std::thread(&NES::EmulatorThread, this);
     for(;;) {
-        io_->screen_refresh();
-
-#if 0
-        // This is ifdef'd out in favor of sleeping in the audio loop
-        // to lock to the right frame rate.
-        t1 = io_->clock_nanos();
-        ns = int64_t(1e9 / FLAGS_fps) - (t1 - t0);
-        if (ns > 200) {
-            sleep_nanos(ns - 100);
+        // Refresh for every new frame, and at the frame rate while paused
+        // so the debug windows stay live.
+        uint64_t now = io_->clock_nanos();
+        bool fresh = Present();
+        if (fresh || now - refreshed >= interval) {
+            if (!fresh)
+                frames_->Repeat();
+            io_->screen_refresh();
+            refreshed = now;
+        } else {
+            sleep_nanos(1000000);
         }
-        t0 = io_->clock_nanos();
-#endif
-
         if (!io_->emulate())
             break;
+    }
+    quit_ = true;
+    emulator_.join();
+    apu_->Drain();
 
-        if (pause_) {
-            if (!step_)
-                continue;
-            step_ = false;
-        }
-        EmulateFrame();
+    if (!FLAGS_cdl.empty()) {
+        cdl_->Save(FLAGS_cdl);
     }
+    tracer_->Stop();
+    recorder_->Stop();
+    ntsc_->set_enabled(false);
 }
 
 void NES::IRQ() {
@@ -558,19 +836,98 @@ void NES::WriteWords(int argc, char **argv) {
     }
 }
 
+void NES::ListCheats() {
+    for(const auto& c : mem_->cheats()) {
+        if (c.second.compare == -1)
+            console_.AddLog("  %04x: %02x", c.first, c.second.val);
+        else
+            console_.AddLog("  %04x: %02x if %02x", c.first, c.second.val,
+                            c.second.compare);
+    }
+}
+
 void NES::NailByte(int argc, char **argv) {
     if (argc < 3) {
         console_.AddLog("[error] %s: Wrong number of arguments.", argv[0]);
         console_.AddLog("[error] %s <addr> <val> ...", argv[0]);
-        for(const auto& n : nailed_)
-            console_.AddLog("  %04x: %02x", n.first, n.second);
+        ListCheats();
         return;
     }
 
     uint16_t addr = strtoul(argv[1], 0, 0);
     for(int i=2; i<argc; i++) {
         uint8_t val = strtoul(argv[i], 0, 0);
-        nailed_[addr++] = val;
+        mem_->AddCheat(addr++, val);
+    }
+}
+
+// Decodes a Game Genie code (6 or 8 letters) or a Pro Action Replay code
+// (AAAAVV or AAAA:VV).
+static bool DecodeCheat(const char* code, uint16_t* addr, uint8_t* val,
+                        int* compare) {
+    static const char letters[] = "APZLGITYEOXUKSVN";
+    int n[8];
+    int len = strlen(code);
+    *compare = -1;
+
+    if (len == 6 || len == 8) {
+        int i;
+        for(i=0; i<len; i++) {
+            const char* p = strchr(letters, toupper(code[i]));
+            if (p == nullptr || *p == '\0')
+                break;
+            n[i] = p - letters;
+        }
+        if (i == len) {
+            *addr = 0x8000 |
+                    ((n[3] & 7) << 12) | ((n[5] & 7) << 8) | ((n[4] & 8) << 8) |
+                    ((n[2] & 7) << 4) | ((n[1] & 8) << 4) |
+                    (n[4] & 7) | (n[3] & 8);
+            *val = ((n[1] & 7) << 4) | ((n[0] & 8) << 4) | (n[0] & 7);
+            if (len == 6) {
+                *val |= n[5] & 8;
+            } else {
+                *val |= n[7] & 8;
+                *compare = ((n[7] & 7) << 4) | ((n[6] & 8) << 4) |
+                           (n[6] & 7) | (n[5] & 8);
+            }
+            return true;
+        }
+    }
+
+    char *end;
+    unsigned long v = strtoul(code, &end, 16);
+    if (*end == ':' && end - code <= 4) {
+        *addr = v;
+        *val = strtoul(end + 1, &end, 16);
+        return *end == '\0';
+    }
+    if (*end == '\0' && len == 6) {
+        *addr = v >> 8;
+        *val = v;
+        return true;
+    }
+    return false;
+}
+
+void NES::CheatCode(int argc, char **argv) {
+    if (argc < 2) {
+        console_.AddLog("[error] %s: Wrong number of arguments.", argv[0]);
+        console_.AddLog("[error] %s <code> ...", argv[0]);
+        ListCheats();
+        return;
+    }
+
+    for(int i=1; i<argc; i++) {
+        uint16_t addr;
+        uint8_t val;
+        int compare;
+        if (!DecodeCheat(argv[i], &addr, &val, &compare)) {
+            console_.AddLog("[error] %s: Bad code %s", argv[0], argv[i]);
+            continue;
+        }
+        mem_->AddCheat(addr, val, compare);
+        console_.AddLog("%s: %04x=%02x", argv[i], addr, val);
     }
 }
 
@@ -585,28 +942,43 @@ void NES::UnnailByte(int argc, char **argv) {
     if (argc < 2) {
         console_.AddLog("[error] %s: Wrong number of arguments.", argv[0]);
         console_.AddLog("[error] %s <addr> ...", argv[0]);
-        for(const auto& n : nailed_)
-            console_.AddLog("  %04x: %02x", n.first, n.second);
+        ListCheats();
         return;
     }
 
     for(int i=1; i<argc; i++) {
         uint16_t addr = strtoul(argv[i], 0, 0);
-        nailed_.erase(addr);
+        mem_->RemoveCheat(addr);
     }
 }
 
 void NES::Unassemble(int argc, char **argv) {
-    static uint16_t addr = 0;
+    uint16_t& addr = unassemble_addr_;
+    int& line = unassemble_line_;
 
     if (addr == 0) {
         addr = mem_->read_word(0xFFFC);
     }
     if (argc >= 2) {
         addr = strtoul(argv[1], 0, 0);
+        line = -1;
     }
 
     int len = (argc == 3) ? strtol(argv[2], 0, 0) : 10;
+    if (line < 0) {
+        // Code in PRG ROM comes from the disassembly database, with labels
+        // and xrefs; anything else is decoded from the live bus.
+        int offset = disasm_->Seed(addr);
+        while(disasm_->busy())
+            disasm_->Step();
+        line = disasm_->LineOf(offset);
+    }
+    if (line >= 0) {
+        for(int i=0; i<len && line < disasm_->lines(); i++) {
+            console_.AddLog("%s", disasm_->Line(line++).c_str());
+        }
+        return;
+    }
     for(int i=0; i<len; i++) {
         std::string s = cpu_->Disassemble(&addr);
         console_.AddLog("%s", s.c_str());
@@ -634,60 +1006,3 @@ void NES::Find(int argc, char **argv) {
         }
     }
 }
-
-void NES::SetWatch(int argc, char **argv) {
-    if (argc < 2) {
-        console_.AddLog("[error] %s: Wrong number of arguments.", argv[0]);
-        console_.AddLog("[error] %s <addr>", argv[0]);
-        return;
-    }
-    char type = argv[0][4] ? argv[0][4] : 'w';
-    auto* watch = &watches_;
-    if (type == 'x') watch = &xwatches_;
-    if (type == 'r') watch = &rwatches_;
-
-    Watch w = {0, -1};
-    w.addr = strtoul(argv[1], 0, 0);
-    if (argc == 3)
-        w.val = strtoul(argv[2], 0, 0);
-
-    watch->push_back(w);
-    console_.AddLog("Watches (type=%c):", type);
-    for(unsigned int i=0; i<watch->size(); i++) {
-        w = watch->at(i);
-        console_.AddLog("%u: %04x = %x", i, w.addr, w.val);
-    }
-}
-
-void NES::DelWatch(int argc, char **argv) {
-    if (argc < 1) {
-        console_.AddLog("[error] %s: Wrong number of arguments.", argv[0]);
-        console_.AddLog("[error] %s <addr>", argv[0]);
-        return;
-    }
-    char type = argv[0][4] ? argv[0][4] : 'w';
-    auto* watch = &watches_;
-    if (type == 'x') watch = &xwatches_;
-    if (type == 'r') watch = &rwatches_;
-
-    uint16_t n = strtoul(argv[1], 0, 0);
-    auto it = watch->begin() + n;
-    if (it < watch->end()) watch->erase(it);
-    console_.AddLog("Watches (type=%c):", type);
-    for(unsigned int i=0; i<watch->size(); i++) {
-        auto w = watch->at(i);
-        console_.AddLog("%u: %04x = %x", i, w.addr, w.val);
-    }
-}
-
-void NES::Watcher(const char *msg, const std::vector<Watch>* watch,
-                  Cpu* cpu, uint16_t addr, uint8_t val) {
-    for(const auto w : *watch) {
-        if (w.addr == addr && (w.val == -1 || w.val == val)) {
-            uint16_t sp = 0x100 | cpu->sp();
-            uint16_t tos = mem_->Read(sp+1) | mem_->Read(sp+2) << 8;
-            console_.AddLog(msg,
-                    cpu->pc(), val, addr, cpu->a(), cpu->x(), cpu->y(), sp, tos);
-        }
-    }
-}
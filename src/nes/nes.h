@@ -1,21 +1,35 @@
 #ifndef EMUDORE_SRC_NES_NES_H
 #define EMUDORE_SRC_NES_NES_H
-#include <string>
+#include <atomic>
+#include <condition_variable>
 #include <map>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <SDL2/SDL.h>
+#include "src/cpu2.h"
 #include "src/io.h"
 #include "src/nes/debug_console.h"
+#include "src/nes/spsc_queue.h"
 #include "proto/nes.pb.h"
 
 class APU;
-class Cpu;
+class Breakpoints;
 class Cartridge;
+class CodeDataLogger;
 class Controller;
 class Debugger;
+class Disassembly;
 class FM2Movie;
+class FrameQueue;
 class Mapper;
 class Mem;
+class NsfPlayer;
+class NtscFilter;
 class PPU;
+class Profiler;
+class Recorder;
+class Tracer;
 
 class NES {
   public:
@@ -25,8 +39,11 @@ class NES {
     void IRQ();
     void NMI();
 
+    inline Breakpoints* breakpoints() { return breakpoints_; }
     inline Cartridge* cartridge() { return cart_; }
+    inline CodeDataLogger* cdl() { return cdl_; }
     inline Controller* controller(int n) { return controller_[n]; }
+    inline Disassembly* disassembly() { return disasm_; }
     inline int controller_size() const {
         return int(sizeof(controller_) / sizeof(controller_[0]));
     }
@@ -35,15 +52,39 @@ class NES {
     inline IO* io() { return io_; }
     inline Mapper* mapper() { return mapper_; }
     inline Mem* memory() { return mem_; }
+    inline NsfPlayer* nsf() { return nsf_; }
+    inline NtscFilter* ntsc() { return ntsc_; }
     inline FM2Movie* movie() { return movie_; }
+    inline FrameQueue* frames() { return frames_; }
     inline PPU* ppu() { return ppu_; }
+    inline Profiler* profiler() { return profiler_; }
+    inline Recorder* recorder() { return recorder_; }
+    inline Tracer* tracer() { return tracer_; }
+    inline DebugConsole* console() { return &console_; }
     inline uint32_t palette(uint8_t c) { return palette_[c % 64]; }
+    // The host palette with the given PPU color emphasis bits applied.
+    inline const uint32_t* palette_table(uint8_t emphasis) {
+        return emphasized_[emphasis % 8];
+    }
+    inline uint32_t palette_version() const { return palette_version_; }
     inline uint64_t frame() { return frame_; }
 
     int cpu_cycles();
     inline void yield() const { io_->yield(); }
     inline void sleep_nanos(uint64_t ns) const { io_->sleep_nanos(ns); }
     inline void Stall(int s) { stall_ += s; }
+    // Pauses emulation once the current frame completes.
+    inline void Pause() { pause_ = true; }
+
+    // Debug windows call this before they look at or change emulator
+    // state.  The first call in a screen refresh suspends the emulator at
+    // its next frame boundary until the refresh is done.  Refreshes with
+    // no such window open don't wait for the emulator at all.
+    void Live();
+
+    // Emulation speed as a multiple of real time; 0 is unlimited.
+    void set_speed(int speed);
+    inline int speed() const { return speed_; }
 
     void Reset();
     bool Emulate();
@@ -58,26 +99,66 @@ class NES {
   private:
     void DebugStuff(SDL_Renderer* r);
     void DebugPalette(bool* active);
+    bool Present();
+    void EmulatorThread();
+    bool SkipFrame();
+    void Checkpoint();
+    void Suspend();
+    void Resume();
+    void BuildPaletteTables();
     void HandleKeyboard(SDL_Event* event);
     APU* apu_;
+    Breakpoints* breakpoints_;
     Cpu *cpu_;
     Cartridge* cart_;
+    CodeDataLogger* cdl_;
     Controller* controller_[4];
     Debugger* debugger_;
+    Disassembly* disasm_;
     IO* io_;
     Mapper* mapper_;
     Mem* mem_;
+    NsfPlayer* nsf_;
+    NtscFilter* ntsc_;
     FM2Movie* movie_;
+    FrameQueue* frames_;
     PPU* ppu_;
+    Profiler* profiler_;
+    Recorder* recorder_;
+    Tracer* tracer_;
     proto::NES state_;
 
     uint32_t palette_[64];
+    uint32_t emphasized_[8][64];
+    uint32_t palette_version_;
     bool pause_, step_, debug_, reset_;
     int stall_;
     uint64_t frame_;
+    // Tab changes it on the emulator thread; the debug window shows it.
+    std::atomic<int> speed_;
+    uint64_t drawn_at_;
+
+    // Emulation runs on its own thread; Run() presents frames and handles
+    // SDL events.  Input events are queued to the emulator, which applies
+    // them between frames.  Debug windows and console commands run while
+    // the emulator is suspended at a frame boundary, if they need to be.
+    struct InputEvent {
+        bool keyboard;
+        SDL_Event event;
+    };
+    SpscQueue<InputEvent, 256> input_;
+    std::thread emulator_;
+    std::atomic<bool> quit_;
+    std::mutex sync_mutex_;
+    std::condition_variable sync_cv_;
+    bool suspend_, suspended_;
+    // Set by Live for the rest of a refresh.
+    bool live_;
+    // Where the 'u' command continues listing from.
+    uint16_t unassemble_addr_;
+    int unassemble_line_;
 
     DebugConsole console_;
-    std::map<uint16_t, uint8_t> nailed_;
     void HexdumpBytes(int argc, char **argv);
     void HexdumpWords(int argc, char **argv);
     void WriteBytes(int argc, char **argv);
@@ -89,20 +170,10 @@ class NES {
 
     void NailByte(int argc, char **argv);
     void UnnailByte(int argc, char **argv);
+    void CheatCode(int argc, char **argv);
+    void ListCheats();
     void Unassemble(int argc, char **argv);
     void Find(int argc, char **argv);
-    void SetWatch(int argc, char **argv);
-    void DelWatch(int argc, char **argv);
-
-    struct Watch {
-        uint16_t addr;
-        int val;
-    };
-    void Watcher(const char* msg, const std::vector<Watch>* watch,
-            Cpu* cpu, uint16_t addr, uint8_t val);
-    std::vector<Watch> watches_;
-    std::vector<Watch> xwatches_;
-    std::vector<Watch> rwatches_;
 };
 
 #endif // EMUDORE_SRC_NES_NES_H
@@ -0,0 +1,258 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <gflags/gflags.h>
+#include "imgui.h"
+
+#include "src/nes/nsf.h"
+
+#include "src/nes/apu.h"
+#include "src/nes/apu_vrc6.h"
+#include "src/nes/cartridge.h"
+#include "src/nes/mapper.h"
+#include "src/nes/mem.h"
+#include "src/nes/recorder.h"
+
+DEFINE_int32(nsf_track, 0, "NSF track to play, counted from 1.  0 plays "
+             "the file's starting track.");
+
+namespace {
+const uint16_t kDriver = 0x4100;
+// The driver's idle loop, its PLAY caller and a bare RTI.
+const uint16_t kIdle = kDriver + 7;
+const uint16_t kPlay = kDriver + 10;
+const uint16_t kRti = kDriver + 13;
+// Give up on an INIT routine that hasn't returned after two seconds.
+const uint64_t kInitCycles = 2 * NES::frequency;
+}  // namespace
+
+// Maps 4K pages at $8000-$FFFF through the bank registers at $5FF8-$5FFF,
+// the driver at $4100 and the vectors.  $6000-$7FFF is RAM.  Tunes for
+// VRC6 get its sound registers at $9000-$B002.
+class NsfMapper: public Mapper {
+  public:
+    NsfMapper(NES* nes):
+        Mapper(nes),
+        pages_(nes_->cartridge()->prglen() / 0x1000),
+        bank_{0, },
+        driver_{0, },
+        vrc6_(nullptr) {
+        expansion_ = true;
+        if (nes_->cartridge()->nsf().chips & kVrc6) {
+            vrc6_ = new Vrc6();
+            nes_->apu()->set_expansion(vrc6_);
+        }
+    }
+
+    void Start(int track) {
+        const Cartridge::NsfHeader& nsf = nes_->cartridge()->nsf();
+        bool banked = false;
+        for(int i=0; i<8; i++)
+            banked |= nsf.bank[i] != 0;
+        for(int i=0; i<8; i++)
+            bank_[i] = banked ? nsf.bank[i] % pages_ : i;
+
+        // LDA #track; LDX #0 (NTSC); JSR init; idle: JMP idle;
+        // play: JSR play; RTI
+        const uint8_t driver[] = {
+            0xA9, uint8_t(track), 0xA2, 0x00,
+            0x20, uint8_t(nsf.init), uint8_t(nsf.init >> 8),
+            0x4C, uint8_t(kIdle), uint8_t(kIdle >> 8),
+            0x20, uint8_t(nsf.play), uint8_t(nsf.play >> 8),
+            0x40,
+        };
+        memcpy(driver_, driver, sizeof(driver));
+        if (vrc6_) {
+            for(uint16_t addr : {0x9002, 0xA002, 0xB002, 0x9003})
+                nes_->apu()->WriteExpansion(addr, 0);
+        }
+    }
+
+    uint8_t Read(uint16_t addr) override {
+        if (addr < 0x2000) {
+            return nes_->cartridge()->ReadChr(addr);
+        } else if (addr >= kDriver && addr < kDriver + sizeof(driver_)) {
+            return driver_[addr - kDriver];
+        } else if (addr >= 0x6000 && addr < 0x8000) {
+            return nes_->cartridge()->ReadSram(addr - 0x6000);
+        } else if (addr >= 0xFFFA) {
+            const uint16_t vectors[] = {kPlay, kDriver, kRti};
+            uint16_t v = vectors[(addr - 0xFFFA) / 2];
+            return (addr & 1) ? v >> 8 : v & 0xFF;
+        } else if (addr >= 0x8000) {
+            return nes_->cartridge()->ReadPrg(PrgOffset(addr));
+        }
+        return 0;
+    }
+
+    int PrgOffset(uint16_t addr) override {
+        if (addr < 0x8000)
+            return -1;
+        return bank_[(addr - 0x8000) >> 12] * 0x1000 + (addr & 0xFFF);
+    }
+
+    int ChrOffset(uint16_t addr) override {
+        return (addr < 0x2000) ? addr : -1;
+    }
+
+    void Write(uint16_t addr, uint8_t val) override {
+        if (addr < 0x2000) {
+            nes_->cartridge()->WriteChr(addr, val);
+        } else if (addr >= 0x5FF8 && addr < 0x6000) {
+            bank_[addr - 0x5FF8] = val % pages_;
+        } else if (addr >= 0x6000 && addr < 0x8000) {
+            nes_->cartridge()->WriteSram(addr - 0x6000, val);
+        } else if (vrc6_ && addr >= 0x9000 && addr < 0xC000 &&
+                   (addr & 0xFFF) < 4) {
+            nes_->apu()->WriteExpansion(addr, val);
+        }
+    }
+
+    // Expansion sound chips, as flagged in the header.
+    static const uint8_t kVrc6 = 0x01;
+
+  private:
+    int pages_;
+    int bank_[8];
+    uint8_t driver_[16];
+    Vrc6* vrc6_;
+};
+
+NsfPlayer::NsfPlayer(NES* nes)
+  : nes_(nes),
+    mapper_(new NsfMapper(nes)),
+    cycles_(0),
+    next_play_(0),
+    skipped_(0) {
+    const Cartridge::NsfHeader& nsf = nes_->cartridge()->nsf();
+    int speed = nsf.ntsc_speed ? nsf.ntsc_speed : 16639;
+    period_ = speed * 1e-6 * NES::frequency;
+    track_ = FLAGS_nsf_track ? FLAGS_nsf_track - 1 : nsf.start - 1;
+    if (track_ < 0 || track_ >= tracks())
+        track_ = 0;
+    nes_->console()->RegisterCommand("nsf", "Show or change the NSF track",
+            [=](int argc, char **argv) {
+        this->Command(argc, argv);
+    });
+}
+
+Mapper* NsfPlayer::mapper() {
+    return mapper_;
+}
+
+int NsfPlayer::tracks() const {
+    return nes_->cartridge()->nsf().songs;
+}
+
+void NsfPlayer::Step() {
+    int n = nes_->cpu()->Emulate();
+    nes_->apu()->Emulate(n);
+    cycles_ += n;
+}
+
+void NsfPlayer::Start(int track) {
+    Mem* mem = nes_->memory();
+    track_ = track;
+    for(uint16_t a=0; a<0x800; a++)
+        mem->write_byte(a, 0);
+    for(uint16_t a=0x6000; a<0x8000; a++)
+        mem->write_byte(a, 0);
+    for(uint16_t a=0x4000; a<0x4014; a++)
+        mem->write_byte(a, 0);
+    mem->write_byte(0x4015, 0x00);
+    mem->write_byte(0x4015, 0x0F);
+    mem->write_byte(0x4017, 0x40);
+
+    mapper_->Start(track);
+    nes_->cpu()->reset();
+    uint64_t limit = cycles_ + kInitCycles;
+    do {
+        Step();
+    } while(nes_->cpu()->pc() != kIdle && cycles_ < limit);
+    if (nes_->cpu()->pc() != kIdle)
+        fprintf(stderr, "NSF INIT for track %d did not return.\n", track + 1);
+    next_play_ = cycles_ + period_;
+    skipped_ = 0;
+}
+
+void NsfPlayer::EmulateFrame() {
+    while(cycles_ < next_play_)
+        Step();
+    next_play_ += period_;
+    if (nes_->cpu()->pc() == kIdle)
+        nes_->cpu()->nmi();
+    else
+        skipped_++;
+}
+
+void NsfPlayer::Render(const std::string& filename, double seconds) {
+    Recorder* recorder = nes_->recorder();
+    size_t number = filename.find("%d");
+    bool all = number != std::string::npos;
+    if (filename.find('%', all ? number + 1 : 0) != std::string::npos ||
+        (all && filename.find('%') != number)) {
+        fprintf(stderr, "%s: The only %% allowed is one %%d.\n",
+                filename.c_str());
+        return;
+    }
+    int first = all ? 0 : track_;
+    int last = all ? tracks() - 1 : track_;
+    int speed = nes_->speed();
+
+    // Nothing is queued to the audio device at unlimited speed, so nothing
+    // paces the emulation.
+    nes_->set_speed(0);
+    for(int t=first; t<=last; t++) {
+        std::string name = filename;
+        if (all)
+            name.replace(number, 2, std::to_string(t + 1));
+        if (!recorder->StartAudio(name)) {
+            fprintf(stderr, "Could not render audio to %s\n", name.c_str());
+            break;
+        }
+        Start(t);
+        uint64_t end = cycles_ + uint64_t(seconds * NES::frequency);
+        while(cycles_ < end)
+            EmulateFrame();
+        nes_->apu()->Drain();
+        recorder->Stop();
+    }
+    nes_->set_speed(speed);
+}
+
+void NsfPlayer::Command(int argc, char **argv) {
+    DebugConsole* console = nes_->console();
+    const Cartridge::NsfHeader& nsf = nes_->cartridge()->nsf();
+    if (argc > 2) {
+        console->AddLog("[error] %s: Wrong number of arguments.", argv[0]);
+        console->AddLog("[error] %s [track]", argv[0]);
+        return;
+    }
+    if (argc == 2) {
+        int track = strtol(argv[1], 0, 0);
+        if (track < 1 || track > tracks()) {
+            console->AddLog("[error] %s: Track must be 1 to %d.", argv[0],
+                            tracks());
+            return;
+        }
+        Start(track - 1);
+    }
+    console->AddLog("%.32s - %.32s (%.32s)", nsf.name, nsf.artist,
+                    nsf.copyright);
+    console->AddLog("Track %d of %d, %lu calls to PLAY skipped",
+                    track_ + 1, tracks(), (unsigned long)skipped_);
+}
+
+void NsfPlayer::DebugStuff() {
+    const Cartridge::NsfHeader& nsf = nes_->cartridge()->nsf();
+    ImGui::Text("%.32s", nsf.name);
+    ImGui::Text("%.32s (%.32s)", nsf.artist, nsf.copyright);
+    int track = track_ + 1;
+    if (ImGui::SliderInt("Track", &track, 1, tracks()))
+        Start(track - 1);
+    ImGui::SameLine();
+    if (ImGui::Button("Restart"))
+        Start(track_);
+    ImGui::Text("PLAY every %.0f cycles, %lu skipped", period_,
+                (unsigned long)skipped_);
+}
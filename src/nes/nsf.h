@@ -0,0 +1,50 @@
+#ifndef EMUDORE_SRC_NES_NSF_H
+#define EMUDORE_SRC_NES_NSF_H
+#include <cstdint>
+#include <string>
+
+#include "src/nes/nes.h"
+
+class Mapper;
+class NsfMapper;
+
+// Plays NES Sound Format files: a game's music driver and data, with the
+// addresses of its INIT and PLAY routines.
+//
+// Only the CPU and APU run.  A small driver mapped at $4100 loads the track
+// number, calls INIT and then idles; the player raises NMI at the file's
+// play rate, and the NMI handler calls PLAY.  The vectors are overlaid on
+// whatever banks the tune maps in.  A call to PLAY is skipped if the
+// previous one hasn't returned yet.
+class NsfPlayer {
+  public:
+    NsfPlayer(NES* nes);
+
+    Mapper* mapper();
+    inline int track() const { return track_; }
+    int tracks() const;
+
+    // Resets the machine and runs INIT for |track| (counted from zero).
+    void Start(int track);
+    // Runs up to the next call to PLAY.
+    void EmulateFrame();
+    // Renders |seconds| of audio to WAV as fast as possible.  If |filename|
+    // contains %d, every track is rendered, numbered from 1.
+    void Render(const std::string& filename, double seconds);
+
+    void Command(int argc, char **argv);
+    void DebugStuff();
+  private:
+    void Step();
+
+    NES* nes_;
+    NsfMapper* mapper_;
+    int track_;
+    uint64_t cycles_;
+    // CPU cycles between calls to PLAY, and when the next one is due.
+    double period_;
+    double next_play_;
+    uint64_t skipped_;
+};
+
+#endif // EMUDORE_SRC_NES_NSF_H
@@ -0,0 +1,272 @@
+#include <cmath>
+#include <cstring>
+
+#include "imgui.h"
+#include "src/nes/ntsc.h"
+
+namespace {
+// Composite levels relative to sync, from the nesdev wiki: the low then
+// high halves of the square wave for each of the four luma levels.
+const float kLevels[8] = {
+    0.228f, 0.312f, 0.552f, 0.880f,
+    0.616f, 0.840f, 1.100f, 1.100f,
+};
+const float kBlack = 0.312f;
+const float kWhite = 1.100f;
+const float kAttenuate = 0.746f;
+// Aligns the demodulator with the color burst (color 8), in samples.
+const float kHueOffset = 3.9f;
+const float kPi = 3.14159265f;
+
+inline bool InColorPhase(int color, int phase) {
+    return (color + phase) % 12 < 6;
+}
+
+// The signal level of a 9-bit pixel (emphasis and palette index) at one
+// of the twelve phases of the color subcarrier.
+float Signal(int pixel, int phase) {
+    int color = pixel & 0x0F;
+    int level = (pixel >> 4) & 3;
+    int emphasis = pixel >> 6;
+
+    if (color > 13)
+        level = 1;
+    float lo = kLevels[level];
+    float hi = kLevels[4 + level];
+    if (color == 0)
+        lo = hi;
+    if (color > 12)
+        hi = lo;
+    float signal = InColorPhase(color, phase) ? hi : lo;
+
+    if (((emphasis & 1) && InColorPhase(0xC, phase)) ||
+        ((emphasis & 2) && InColorPhase(0x4, phase)) ||
+        ((emphasis & 4) && InColorPhase(0x8, phase))) {
+        signal *= kAttenuate;
+    }
+    return signal;
+}
+}  // namespace
+
+NtscFilter::NtscFilter()
+  : enabled_(false),
+    settings_{0.25f, 0.0f, 1.0f, false},
+    dirty_(true),
+    done_(false),
+    pending_(false),
+    input_(256 * 240 + 240 + 1),
+    front_(kWidth * kHeight * 2),
+    back_(kWidth * kHeight * 2),
+    front_rows_(kHeight),
+    submitted_(0),
+    filtered_(0),
+    presented_(0) {
+    for(int i=0; i<1024; i++) {
+        gamma_[i] = uint8_t(255.0 * pow(i / 1023.0, 2.2 / 1.8) + 0.5);
+    }
+}
+
+NtscFilter::~NtscFilter() {
+    set_enabled(false);
+}
+
+void NtscFilter::set_enabled(bool enabled) {
+    if (enabled == enabled_)
+        return;
+    if (enabled) {
+        done_ = false;
+        pending_ = false;
+        submitted_ = 0;
+        filtered_ = 0;
+        presented_ = 0;
+        worker_ = std::thread(&NtscFilter::Worker, this);
+    } else {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_ = true;
+        }
+        cv_.notify_one();
+        worker_.join();
+    }
+    enabled_ = enabled;
+}
+
+void NtscFilter::Submit(const uint8_t* picture, const uint8_t* emphasis,
+                        int phase) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // An unfiltered frame still in the input is simply replaced.
+        memcpy(&input_[0], picture, 256 * 240);
+        memcpy(&input_[256 * 240], emphasis, 240);
+        input_[256 * 240 + 240] = phase % 3;
+        pending_ = true;
+        submitted_++;
+    }
+    cv_.notify_one();
+}
+
+void NtscFilter::Present(IO* io) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (filtered_ != presented_) {
+        io->screen_blit(front_.data(), kWidth, front_rows_);
+        presented_ = filtered_;
+    }
+}
+
+void NtscFilter::Worker() {
+    std::vector<uint8_t> input(input_.size());
+    for(;;) {
+        Settings s;
+        bool rebuild;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]{ return pending_ || done_; });
+            if (done_)
+                break;
+            input.swap(input_);
+            pending_ = false;
+            s = settings_;
+            rebuild = dirty_;
+            dirty_ = false;
+        }
+        if (rebuild)
+            BuildTables(s);
+        Filter(s, input.data(), back_.data());
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            front_.swap(back_);
+            front_rows_ = s.scanlines ? kHeight * 2 : kHeight;
+            filtered_++;
+        }
+    }
+}
+
+void NtscFilter::BuildTables(const Settings& s) {
+    float hue = kHueOffset + s.hue / 30.0f;
+    float scale = 1.0f / (kWhite - kBlack);
+    for(int p=0; p<3; p++) {
+        for(int pixel=0; pixel<512; pixel++) {
+            for(int k=0; k<8; k++) {
+                int phase = (p * 4 + k) % 12;
+                float signal = Signal(pixel, phase);
+                float* yiq = yiq_[p][pixel][k];
+                yiq[0] = (signal - kBlack) * scale;
+                yiq[1] = signal * scale * s.saturation *
+                         cos(kPi * (phase + hue) / 6.0f);
+                yiq[2] = signal * scale * s.saturation *
+                         sin(kPi * (phase + hue) / 6.0f);
+            }
+        }
+    }
+}
+
+void NtscFilter::Filter(const Settings& s, const uint8_t* in, uint32_t* out) {
+    const uint8_t* emphasis = in + 256 * 240;
+    int phase = in[256 * 240 + 240];
+    for(int y=0; y<kHeight; y++) {
+        // The color phase advances by 4 samples each scanline.
+        int line_phase = (phase + y) % 3;
+        if (s.scanlines) {
+            uint32_t* row = out + y * 2 * kWidth;
+            FilterLine(s, in + y * 256, emphasis[y], line_phase, row);
+            for(int x=0; x<kWidth; x++) {
+                row[kWidth + x] = 0xFF000000 |
+                                  ((row[x] >> 2) & 0x003F3F3F) * 3;
+            }
+        } else {
+            FilterLine(s, in + y * 256, emphasis[y], line_phase,
+                       out + y * kWidth);
+        }
+    }
+}
+
+void NtscFilter::FilterLine(const Settings& s, const uint8_t* pixels,
+                            uint8_t emphasis, int phase, uint32_t* out) {
+    static const int kBorder = kChromaWindow;
+    static const int kLength = kSamples + 2 * kBorder;
+    float* ys = sum_[0];
+    float* is = sum_[1];
+    float* qs = sum_[2];
+
+    // The border is black, which has no chroma and zero luma.
+    ys[0] = is[0] = qs[0] = 0;
+    for(int n=0; n<kBorder; n++) {
+        ys[n + 1] = is[n + 1] = qs[n + 1] = 0;
+    }
+    int n = kBorder;
+    for(int x=0; x<256; x++) {
+        // Each pixel is 8 samples, so its phase advances by 8 (mod 12).
+        int p = (phase + x * 2) % 3;
+        const float (*yiq)[3] = yiq_[p][(emphasis << 6) | (pixels[x] & 0x3F)];
+        for(int k=0; k<8; k++, n++) {
+            ys[n + 1] = ys[n] + yiq[k][0];
+            is[n + 1] = is[n] + yiq[k][1];
+            qs[n + 1] = qs[n] + yiq[k][2];
+        }
+    }
+    for(; n<kLength; n++) {
+        ys[n + 1] = ys[n];
+        is[n + 1] = is[n];
+        qs[n + 1] = qs[n];
+    }
+
+    int luma = int(12.0f - 8.0f * s.sharpness + 0.5f);
+    if (luma < 2) luma = 2;
+    if (luma > 2 * kBorder) luma = 2 * kBorder;
+    float ly = 1.0f / luma;
+    float lc = 2.0f / kChromaWindow;
+    for(int x=0; x<kWidth; x++) {
+        int center = kBorder + (x * 2 + 1) * kSamples / (kWidth * 2);
+        int y0 = center - luma / 2;
+        int c0 = center - kChromaWindow / 2;
+        float Y = (ys[y0 + luma] - ys[y0]) * ly;
+        float I = (is[c0 + kChromaWindow] - is[c0]) * lc;
+        float Q = (qs[c0 + kChromaWindow] - qs[c0]) * lc;
+
+        float rgb[3] = {
+            Y + 0.956f * I + 0.621f * Q,
+            Y - 0.272f * I - 0.647f * Q,
+            Y - 1.106f * I + 1.703f * Q,
+        };
+        uint32_t pixel = 0xFF000000;
+        for(int c=0; c<3; c++) {
+            int v = int(rgb[c] * 1023.0f);
+            if (v < 0) v = 0;
+            if (v > 1023) v = 1023;
+            pixel |= uint32_t(gamma_[v]) << (c * 8);
+        }
+        out[x] = pixel;
+    }
+}
+
+void NtscFilter::DebugStuff(bool* active) {
+    if (!*active)
+        return;
+
+    ImGui::Begin("NTSC Filter", active);
+    bool enabled = enabled_;
+    if (ImGui::Checkbox("Enabled", &enabled))
+        set_enabled(enabled);
+
+    Settings s;
+    uint64_t submitted, filtered;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        s = settings_;
+        submitted = submitted_;
+        filtered = filtered_;
+    }
+    bool changed = false;
+    changed |= ImGui::SliderFloat("Sharpness", &s.sharpness, -1.0f, 1.0f);
+    changed |= ImGui::SliderFloat("Hue", &s.hue, -45.0f, 45.0f, "%.0f deg");
+    changed |= ImGui::SliderFloat("Saturation", &s.saturation, 0.0f, 2.0f);
+    changed |= ImGui::Checkbox("Scanlines", &s.scanlines);
+    if (changed) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        settings_ = s;
+        dirty_ = true;
+    }
+    ImGui::Text("%lu frames filtered, %lu dropped",
+                (unsigned long)filtered, (unsigned long)(submitted - filtered));
+    ImGui::End();
+}
@@ -0,0 +1,85 @@
+#ifndef EMUDORE_SRC_NES_NTSC_H
+#define EMUDORE_SRC_NES_NTSC_H
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "src/io.h"
+
+// Simulates the NES composite video signal.
+//
+// Each PPU pixel is turned into the eight samples of the square-wave
+// composite signal the PPU generates for its palette index and emphasis
+// bits, then decoded back into YIQ by box-filtering luma and demodulating
+// chroma, the way a TV would.  Luma filter width is set by the sharpness;
+// anything short of a full color cycle lets chroma leak into luma and
+// gives the familiar fringing and (since the color phase moves every
+// frame) dot crawl.
+//
+// Filtering runs on a worker thread: Submit() hands over the PPU's index
+// buffer, and Present() blits the newest finished frame, so the picture
+// lags the emulator by a frame.
+class NtscFilter {
+  public:
+    static const int kWidth = 602;
+    static const int kHeight = 240;
+
+    NtscFilter();
+    ~NtscFilter();
+
+    inline bool enabled() const { return enabled_; }
+    void set_enabled(bool enabled);
+
+    // picture is 256x240 palette indices, emphasis the per-scanline
+    // emphasis bits and phase the frame's color phase (0-2).
+    void Submit(const uint8_t* picture, const uint8_t* emphasis, int phase);
+    void Present(IO* io);
+
+    void DebugStuff(bool* active);
+
+  private:
+    struct Settings {
+        float sharpness;
+        float hue;
+        float saturation;
+        bool scanlines;
+    };
+    static const int kSamples = 256 * 8;
+    static const int kChromaWindow = 24;
+
+    void Worker();
+    void BuildTables(const Settings& s);
+    void Filter(const Settings& s, const uint8_t* in, uint32_t* out);
+    void FilterLine(const Settings& s, const uint8_t* pixels, uint8_t emphasis,
+                    int phase, uint32_t* out);
+
+    bool enabled_;
+    Settings settings_;
+    bool dirty_;
+
+    std::thread worker_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool done_;
+    bool pending_;
+    std::vector<uint8_t> input_;
+    std::vector<uint32_t> front_;
+    std::vector<uint32_t> back_;
+    int front_rows_;
+    uint64_t submitted_;
+    uint64_t filtered_;
+    uint64_t presented_;
+
+    // Y, I and Q of each signal sample of each color (index plus
+    // emphasis) at each of the three pixel phases.
+    float yiq_[3][512][8][3];
+    // Running sums of Y, I and Q along the current line, which has
+    // kChromaWindow samples of black border on each side.
+    float sum_[3][kSamples + 2 * kChromaWindow + 1];
+    // Gamma corrected 8-bit values for color components in [0, 1].
+    uint8_t gamma_[1024];
+};
+
+#endif // EMUDORE_SRC_NES_NTSC_H
@@ -5,10 +5,12 @@
 
 #include "src/pbmacro.h"
 #include "src/nes/cartridge.h"
+#include "src/nes/cdl.h"
 #include "src/nes/fm2.h"
 #include "src/nes/ppu.h"
 #include "src/nes/mem.h"
 #include "src/nes/mapper.h"
+#include "src/nes/recorder.h"
 #include "src/io.h"
 
 namespace {
@@ -31,24 +33,27 @@ void IntVal(T* thing, uint32_t val) {
 
 PPU::PPU(NES* nes)
     : nes_(nes),
+    cdl_(nullptr),
+    skip_(false),
     cycle_(0), scanline_(0), frame_(0),
     oam_{0, },
     v_(0), t_(0), x_(0), w_(0), f_(0), register_(0),
     nmi_{0,},
-    nametable_(0), attrtable_(0), lowtile_(0), hightile_(0), tiledata_(0),
+    nametable_(0), attrtable_(0), tilepattern_(0), tiledata_(0),
+    bg_tile_(false), bg_chr_(0),
+    a12_high_(0), a12_sprites_(0), a12_next_(-1),
     sprite_{0,},
     control_{0,},
     mask_{0,},
     status_{0,},
     oam_addr_(0), buffered_data_(0),
-    picture_{0,} {
-    BuildExpanderTables();
+    output_(nes->frames()->back()) {
 }
 
 void PPU::LoadState(proto::PPU* state) {
     LOAD(cycle, scanline, frame,
          v, t, x, w, f,
-         nametable, attrtable, lowtile, hightile, tiledata,
+         nametable, attrtable, tilepattern, tiledata,
          oam_addr, buffered_data);
     LOAD_FIELD(ppuregister, register_);
     IntVal(&nmi_, state->nmi());
@@ -67,12 +72,15 @@ void PPU::LoadState(proto::PPU* state) {
         sprite_.priority[i] = state->sprite(i).priority();
         sprite_.index[i] = state->sprite(i).index();
     }
+    a12_sprites_ = 0;
+    a12_next_ = -1;
+    bg_tile_ = false;
 }
 
 void PPU::SaveState(proto::PPU* state) {
     SAVE(cycle, scanline, frame,
          v, t, x, w, f,
-         nametable, attrtable, lowtile, hightile, tiledata,
+         nametable, attrtable, tilepattern, tiledata,
          oam_addr, buffered_data);
     SAVE_FIELD(ppuregister, register_);
     state->set_nmi(IntVal(&nmi_));
@@ -99,6 +107,9 @@ void PPU::Reset() {
     set_control(0);
     set_mask(0);
     oam_addr_ = 0;
+    a12_sprites_ = 0;
+    a12_next_ = -1;
+    bg_tile_ = false;
 }
 
 void PPU::NmiChange() {
@@ -255,7 +266,12 @@ void PPU::CopyY() {
 void PPU::SetVerticalBlank() {
     nmi_.occured = true;
     NmiChange();
-    nes_->io()->screen_blit(picture_);
+    if (!skip_) {
+        output_->number = frame_;
+        nes_->recorder()->Frame(*output_);
+        nes_->frames()->Publish();
+        output_ = nes_->frames()->back();
+    }
 }
 
 void PPU::ClearVerticalBlank() {
@@ -265,48 +281,76 @@ void PPU::ClearVerticalBlank() {
 
 void PPU::FetchNameTableByte() {
     nametable_ = nes_->memory()->PPURead(0x2000 | (v_ & 0x0FFF));
+    bg_tile_ = false;
+    if (nes_->mapper()->bg_tiles())
+        FetchBgTile();
+}
+
+void PPU::FetchBgTile() {
+    // The fetches at dots 321-336 are the first two tiles of the next line.
+    int column, line;
+    if (cycle_ >= 321) {
+        column = (cycle_ - 321) / 8;
+        line = scanline_ == 261 ? 0 : scanline_ + 1;
+    } else {
+        column = (cycle_ - 1) / 8 + 2;
+        line = scanline_;
+    }
+    Mapper::BgTile tile = {nametable_, 0, 0};
+    if (nes_->mapper()->FetchBgTile(v_, column, line, &tile)) {
+        nametable_ = tile.name;
+        attrtable_ = (tile.palette & 3) << 2;
+        bg_chr_ = tile.chr;
+        bg_tile_ = true;
+    }
 }
 
 void PPU::FetchAttributeByte() {
+    if (bg_tile_)
+        return;
     uint16_t a = 0x23C0 | (v_ & 0x0C00) | ((v_ >> 4) & 0x38) | ((v_ >> 2) & 7);
     uint8_t shift = ((v_ >> 4) & 4) | (v_ & 2);
     attrtable_ = ((nes_->memory()->PPURead(a) >> shift) & 3) << 2;
 }
 
 void PPU::FetchLowTileByte() {
+    if (bg_tile_) {
+        tilepattern_ = PatternRow(bg_chr_, false);
+        return;
+    }
     uint16_t a = (0x1000 * control_.bgtable) + (16 * nametable_) +
                  ((v_ >> 12) & 7);
     // Fetch both the low and high bytes in one call
-    nes_->mapper()->ReadChr2(a, &lowtile_, &hightile_);
+    tilepattern_ = FetchPattern(a, false, false);
+    if (nes_->mapper()->watch_a12()) {
+        uint64_t now = dot();
+        WatchA12(a, now, now + 2);
+    }
 }
 
 void PPU::FetchHighTileByte() {
     // Used to fetch the high byte here, but now nothing
 }
 
-void PPU::BuildExpanderTables() {
-    // Precompute expanded 8-bit patterns into 32-bits to we can build the
-    // pattern+attribute words later without any loops.
-    // We compute both the normal and reflected value:
-    // 8 bit abcdefgh -> 000a000b000c000d000e000f000g000h
-    //                -> 000h000g000f000e000d000c000b000a
-    uint8_t val;
-    for(int n=0; n<256; n++) {
-        uint32_t data = 0;
-        val = n;
-        for(int bit=0; bit<8; bit++) {
-            data = (data<<4) | (val & 0x80)>>7;
-            val <<= 1;
-        }
-        reflection_table_[n] = data;
+uint32_t PPU::FetchPattern(uint16_t addr, bool flip, bool sprite) {
+    Mapper* mapper = nes_->mapper();
+    const int* pages = mapper->chr_pages(sprite, control_.spritesize);
+    int offset = pages ? pages[addr >> 10] + (addr & 0x3FF)
+                       : mapper->ChrOffset(addr);
+    if (offset >= 0)
+        return PatternRow(offset, flip);
 
-        val = n;
-        for(int bit=0; bit<8; bit++) {
-            data = (data<<4) | (val & 1);
-            val >>= 1;
-        }
-        normal_table_[n] = data;
+    uint8_t a, b;
+    mapper->ReadChr2(addr, &a, &b);
+    return TileCache::Expand(a, b, flip);
+}
+
+uint32_t PPU::PatternRow(int offset, bool flip) {
+    if (cdl_) {
+        cdl_->LogChr(offset, CodeDataLogger::RENDERED);
+        cdl_->LogChr(offset + 8, CodeDataLogger::RENDERED);
     }
+    return nes_->cartridge()->tiles()->Row(offset, flip);
 }
 
 void PPU::StoreTileData() {
@@ -314,7 +358,7 @@ void PPU::StoreTileData() {
     // Expand the 2-bit attribute value into every nybble of the word
     // so we can just or it with the tile pattern data.
     uint32_t aa = 0x11111111 * uint32_t(attrtable_);
-    data = reflection_table_[lowtile_] | reflection_table_[hightile_]<<1;
+    data = tilepattern_;
     tiledata_ |= (data | aa);
 }
 
@@ -344,6 +388,12 @@ uint16_t PPU::SpritePixel() {
 
 
 void PPU::RenderPixel() {
+    // When skipping, only sprite 0 hits matter, and only until the first.
+    // Sprite 0 is always first in the list when it's on the line.
+    if (skip_ && (status_.sprite0_hit ||
+                  sprite_.count == 0 || sprite_.index[0] != 0))
+        return;
+
     int x = cycle_ - 1;
     int y = scanline_;
     uint8_t background = BackgroundPixel();
@@ -373,7 +423,14 @@ void PPU::RenderPixel() {
             color = background;
         }
     }
-    picture_[y * 256 + x] = nes_->palette(nes_->memory()->PaletteRead(color));
+    if (skip_)
+        return;
+    if (x == 0)
+        output_->emphasis[y] = *(uint8_t*)&mask_ >> 5;
+    color = nes_->memory()->PaletteRead(color) & 0x3F;
+    if (mask_.grayscale)
+        color &= 0x30;
+    output_->picture[y * 256 + x] = color;
 }
 
 uint32_t PPU::FetchSpritePattern(int i, int row) {
@@ -398,16 +455,8 @@ uint32_t PPU::FetchSpritePattern(int i, int row) {
 
     addr = 0x1000 * table + tile * 16 + row;
     uint8_t a = (attr & 3) << 2;
-    uint8_t lo, hi;
-    nes_->mapper()->ReadChr2(addr, &lo, &hi);
     uint32_t result = 0x11111111 * uint32_t(a);
-
-    if (attr & 0x40) {
-        result |= normal_table_[lo] | normal_table_[hi]<<1;
-    } else {
-        result |= reflection_table_[lo] | reflection_table_[hi]<<1;
-    }
-    return result;
+    return result | FetchPattern(addr, attr & 0x40, true);
 }
 
 void PPU::EvaluateSprites() {
@@ -438,6 +487,53 @@ void PPU::EvaluateSprites() {
     sprite_.count = count;
 }
 
+void PPU::WatchA12(uint16_t addr, uint64_t first, uint64_t last) {
+    if (!(addr & 0x1000))
+        return;
+    // Between the last background fetch of one line and the first of the
+    // next, A12 is low for about 10 dots, which is not long enough.
+    if (first - a12_high_ > kA12Filter)
+        nes_->mapper()->RiseA12();
+    a12_high_ = last;
+}
+
+void PPU::ScheduleSpriteA12() {
+    // Each slot's pattern bytes are fetched at dots 261 and 263 of its
+    // eight; empty slots fetch tile $FF.
+    const uint64_t line = dot() - cycle_;
+    a12_sprites_ = 0;
+    for(int i=0; i<8; i++) {
+        bool high;
+        if (control_.spritesize) {
+            high = i < sprite_.count ? oam_[sprite_.index[i]*4 + 1] & 1 : 1;
+        } else {
+            high = control_.spritetable;
+        }
+        if (!high)
+            continue;
+        uint64_t t = line + 261 + 8 * i;
+        if (t - a12_high_ > kA12Filter)
+            a12_sprites_ |= 1 << i;
+        a12_high_ = t + 2;
+    }
+    a12_next_ = -1;
+    SpriteA12();
+}
+
+void PPU::SpriteA12() {
+    if (a12_next_ != -1) {
+        a12_sprites_ &= a12_sprites_ - 1;
+        nes_->mapper()->RiseA12();
+    }
+    a12_next_ = -1;
+    for(int i=0; i<8; i++) {
+        if (a12_sprites_ & (1 << i)) {
+            a12_next_ = 261 + 8 * i;
+            break;
+        }
+    }
+}
+
 void PPU::Tick() {
     if (nmi_.delay) {
         nmi_.delay--;
@@ -509,8 +605,12 @@ void PPU::Emulate() {
             } else {
                 sprite_.count = 0;
             }
+            if (render_line && nes_->mapper()->watch_a12())
+                ScheduleSpriteA12();
         }
     }
+    if (cycle_ == a12_next_)
+        SpriteA12();
 
     if (scanline_ == 241 && cycle_ == 1) {
         SetVerticalBlank();
@@ -521,6 +621,11 @@ void PPU::Emulate() {
         status_.sprite_overflow = 0;
     }
     if (cycle_ == 1) {
+        if (nes_->mapper()->watch_lines()) {
+            bool rendering = mask_.showbg || mask_.showsprites;
+            nes_->mapper()->Scanline(rendering && visible_line ? scanline_
+                                                               : -1);
+        }
         scrollreg_[scanline_].x = last_scrollreg_.x;
         scrollreg_[scanline_].y = last_scrollreg_.y;
         scrollreg_[scanline_].nt = last_scrollreg_.nt;
@@ -528,26 +633,56 @@ void PPU::Emulate() {
 
 }
 
-void PPU::TileMemImage(uint32_t* imgbuf, uint16_t addr, int palette,
-                       uint8_t* prefcolor) {
+// Redraws only the tiles whose CHR bank, contents or palette changed since
+// the last call, marking them in view->dirty.  Returns how many there were.
+int PPU::TileMemImage(uint32_t* imgbuf, uint16_t addr, int palette,
+                      uint8_t* prefcolor, TileView* view) {
     uint32_t pal[] = { 0xFF000000, 0xFF666666, 0xFFAAAAAA, 0xFFFFFFFF };
     uint8_t pcol[4];
     int tile = 0;
+    int count = 0;
 
+    uint32_t palette_version = 0;
     if (palette != -1) {
+        palette_version = nes_->memory()->palette_version() +
+                          nes_->palette_version();
         for(int c=0; c<4; c++) {
             pal[c] = nes_->palette(nes_->memory()->PaletteRead(palette*4+c));
         }
     }
+    bool all = palette != view->palette ||
+               palette_version != view->palette_version;
+    view->palette = palette;
+    view->palette_version = palette_version;
 
+    Mapper* mapper = nes_->mapper();
+    TileCache* tiles = nes_->cartridge()->tiles();
     for(int y=0; y<16; y++) {
         for(int x=0; x<16; x++, tile++) {
+            int offset = mapper->ChrOffset(addr+16*tile);
+            // Tiles not backed by CHR memory can't be tracked.
+            uint32_t version = offset < 0 ? 0 : tiles->version(offset);
+            view->dirty[tile] = all || offset < 0 ||
+                                offset != view->offset[tile] ||
+                                version != view->version[tile];
+            if (!view->dirty[tile])
+                continue;
+            view->offset[tile] = offset;
+            view->version[tile] = version;
+            count++;
+
             memset(&pcol, 0, sizeof(pcol));
             for(int row=0; row<8; row++) {
-                uint8_t a, b;
-                nes_->mapper()->ReadChr2(addr+16*tile+row, &a, &b);
-                for(int col=0; col<8; col++, a<<=1, b<<=1) {
-                    int color = ((a & 0x80) >> 7) | ((b & 0x80) >> 6);
+                uint32_t pattern;
+                if (offset >= 0) {
+                    pattern = tiles->Row(offset+row, false);
+                } else {
+                    uint8_t a, b;
+                    mapper->ReadChr2(addr+16*tile+row, &a, &b);
+                    pattern = TileCache::Expand(a, b, false);
+                }
+                for(int col=0; col<8; col++, pattern<<=4) {
+                    int color = pattern >> 28;
                     pcol[color]++;
                     imgbuf[128*(8*y + row) + 8*x + col] = pal[color];
                 }
@@ -563,6 +698,7 @@ void PPU::TileMemImage(uint32_t* imgbuf, uint16_t addr, int palette,
             }
         }
     }
+    return count;
 }
 
 void MakeTexture(GLuint* tid, int x, int y, void* data) {
@@ -585,6 +721,19 @@ void UpdateTexture(GLuint tid, int x, int y, void* data) {
                     GL_RGBA, GL_UNSIGNED_BYTE, data);
 }
 
+// Uploads the w x h rectangle at (x, y) of a texture that is |width|
+// pixels wide.
+void UpdateTextureRect(GLuint tid, int width, int x, int y, int w, int h,
+                       uint32_t* data) {
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, tid);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+    glTexSubImage2D(GL_TEXTURE_2D, 0,
+                    x, y, w, h,
+                    GL_RGBA, GL_UNSIGNED_BYTE, data + y * width + x);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
 void PPU::DebugStuff() {
     static bool display_tiledata, display_vram;
     static uint32_t bank[2][128*128];
@@ -593,9 +742,11 @@ void PPU::DebugStuff() {
     static char palette_colors[8][4][4];
     static uint8_t prefcolor[2][256];
     static int psel[2];
+    static TileView view[2];
     static bool once;
 
     if (!once) {
+        view[0].palette = view[1].palette = -2;
         MakeTexture(&bank_tid[0], 128, 128, bank[0]);
         MakeTexture(&bank_tid[1], 128, 128, bank[1]);
         for(int i=0; i<4; i++) {
@@ -613,13 +764,24 @@ void PPU::DebugStuff() {
         ImGui::EndMenuBar();
     }
 
+    if (display_tiledata || display_vram)
+        nes_->Live();
     if (display_tiledata) {
         ImGui::Begin("Tile Data", &display_tiledata);
         nes_->mapper()->DebugStuff();
         for(int b=0; b<2; b++) {
             ImGui::PushID(b);
-            TileMemImage(bank[b], b*0x1000, psel[b], prefcolor[b]);
-            UpdateTexture(bank_tid[b], 128, 128, bank[b]);
+            int changed = TileMemImage(bank[b], b*0x1000, psel[b],
+                                       prefcolor[b], &view[b]);
+            if (changed > 64) {
+                UpdateTexture(bank_tid[b], 128, 128, bank[b]);
+            } else if (changed) {
+                for(int t=0; t<256; t++) {
+                    if (view[b].dirty[t])
+                        UpdateTextureRect(bank_tid[b], 128, (t % 16) * 8,
+                                          (t / 16) * 8, 8, 8, bank[b]);
+                }
+            }
             ImGui::BeginGroup();
             ImGui::Text(" ");
             float y = ImGui::GetCursorPosY();
@@ -672,9 +834,40 @@ void PPU::DebugVram(bool* active, uint8_t prefcolor[2][256]) {
     static const char hex[] = "0123456789abcdef";
     static Position pos[64][60];
     static Position ntofs[4] = { {0,0}, {32,0}, {0,30}, {32,30} };
+    // Each cell's byte and color, recomputed only when the nametables,
+    // palettes, nametable mapping or preferred tile colors change.
+    static uint8_t cell_val[4][960];
+    static uint32_t cell_color[4][960];
+    static uint32_t nametable_version, palette_version;
+    static int bgtable = -1;
+    static uint8_t last_prefcolor[2][256];
     if (!*active)
         return;
 
+    Mem* mem = nes_->memory();
+    uint32_t pv = mem->palette_version() + nes_->palette_version();
+    if (mem->nametable_version() != nametable_version ||
+        pv != palette_version ||
+        control_.bgtable != bgtable ||
+        memcmp(prefcolor, last_prefcolor, sizeof(last_prefcolor))) {
+        nametable_version = mem->nametable_version();
+        palette_version = pv;
+        bgtable = control_.bgtable;
+        memcpy(last_prefcolor, prefcolor, sizeof(last_prefcolor));
+        for(int n=0; n<4; n++) {
+            for(int i=0; i<960; i++) {
+                uint16_t v = 0x2000 + n * 0x400 + i;
+                uint8_t val = mem->PPURead(v);
+                uint16_t a = 0x23C0 | (v & 0x0C00) | ((v >> 4) & 0x38) | ((v >> 2) & 7);
+                uint8_t shift = ((v >> 4) & 4) | (v & 2);
+                uint8_t attr = ((mem->PPURead(a) >> shift) & 3) << 2;
+                uint8_t pval = mem->PaletteRead(attr + prefcolor[bgtable][val]);
+                cell_val[n][i] = val;
+                cell_color[n][i] = nes_->palette(pval);
+            }
+        }
+    }
+
     ImGui::Begin("Name Tables", active);
     ImGui::Text("Video RAM:");
     ImDrawList* draw_list = ImGui::GetWindowDrawList();
@@ -683,16 +876,11 @@ void PPU::DebugVram(bool* active, uint8_t prefcolor[2][256]) {
         char buf[16];
         int xofs = (v & 0x400) ? 32 : 0;
         int yofs = (v & 0x800) ? 30 : 0;
+        int n = (v >> 10) & 3;
         ImGui::BeginGroup();
         for(int y=0; y<30; y++) {
             for(int x=0; x<32; x++, v++) {
-                uint8_t val = nes_->memory()->PPURead(v);
-
-                uint16_t a = 0x23C0 | (v & 0x0C00) | ((v >> 4) & 0x38) | ((v >> 2) & 7);
-                uint8_t shift = ((v >> 4) & 4) | (v & 2);
-                uint8_t attr = ((nes_->memory()->PPURead(a) >> shift) & 3) << 2;
-                uint8_t pval = nes_->memory()->PaletteRead(
-                        attr + prefcolor[control_.bgtable][val]);
+                uint8_t val = cell_val[n][y * 32 + x];
                 if (x == 0) {
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wformat-security"
@@ -720,7 +908,7 @@ void PPU::DebugVram(bool* active, uint8_t prefcolor[2][256]) {
                 buf[0] = hex[(val>>4) & 0xf];
                 buf[1] = hex[(val>>0) & 0xf];
                 buf[2] = 0;
-                ImGui::TextColored(ImColor(nes_->palette(pval)), buf);
+                ImGui::TextColored(ImColor(cell_color[n][y * 32 + x]), buf);
 #pragma GCC diagnostic pop
             }
         }
@@ -1,9 +1,12 @@
 #ifndef EMUDORE_SRC_NES_PPU_H
 #define EMUDORE_SRC_NES_PPU_H
 #include <cstdint>
+#include "src/nes/frame_queue.h"
 #include "src/nes/nes.h"
 #include "proto/ppu.pb.h"
 
+class CodeDataLogger;
+
 class PPU {
   public:
     struct Mask {
@@ -27,6 +30,9 @@ class PPU {
     inline int scanline() const { return scanline_; }
     inline int cycle() const { return cycle_; }
     inline Mask mask() const { return mask_; }
+    inline void set_cdl(CodeDataLogger* cdl) { cdl_ = cdl; }
+    // Skipped frames are emulated but neither drawn nor published.
+    inline void set_skip(bool skip) { skip_ = skip; }
     void DebugStuff();
     void LoadState(proto::PPU* state);
     void SaveState(proto::PPU* state);
@@ -50,6 +56,9 @@ class PPU {
     void FetchAttributeByte();
     void FetchLowTileByte();
     void FetchHighTileByte();
+    void FetchBgTile();
+    uint32_t FetchPattern(uint16_t addr, bool flip, bool sprite);
+    uint32_t PatternRow(int offset, bool flip);
     void StoreTileData();
     uint8_t BackgroundPixel();
     uint16_t SpritePixel();
@@ -57,9 +66,17 @@ class PPU {
     uint32_t FetchSpritePattern(int i, int row);
     void EvaluateSprites();
     void Tick();
+    inline uint64_t dot() const {
+        return (frame_ * 262 + scanline_) * 341 + cycle_;
+    }
+    void WatchA12(uint16_t addr, uint64_t first, uint64_t last);
+    void ScheduleSpriteA12();
+    void SpriteA12();
 
 
     NES* nes_;
+    CodeDataLogger* cdl_;
+    bool skip_;
 
     int cycle_;
     int scanline_;
@@ -84,8 +101,22 @@ class PPU {
 
     uint8_t nametable_;
     uint8_t attrtable_;
-    uint8_t lowtile_, hightile_;
+    uint32_t tilepattern_;
     uint64_t tiledata_;
+    // Set when the mapper supplied the current background tile; its
+    // palette is already in attrtable_ and bg_chr_ is its CHR row.
+    bool bg_tile_;
+    int bg_chr_;
+
+    // For mappers that count rising edges of PPU address line A12 (MMC3).
+    // The chip ignores edges unless A12 has been low for a few CPU cycles;
+    // a12_high_ is the last dot A12 was high on a pattern fetch.  Edges
+    // from sprite fetches are worked out at dot 257 and delivered on their
+    // own dots: one bit per sprite slot, the next at cycle a12_next_.
+    static const int kA12Filter = 12;
+    uint64_t a12_high_;
+    uint8_t a12_sprites_;
+    int a12_next_;
 
     struct {
         int count;
@@ -114,17 +145,25 @@ class PPU {
     uint8_t oam_addr_;
     uint8_t buffered_data_;
 
-    uint32_t picture_[256*240];
-
-    void TileMemImage(uint32_t* imgbuf, uint16_t addr, int palette, uint8_t *prefcolor);
+    // The frame being rendered: palette indices, with the color emphasis
+    // bits latched at the start of each scanline.  Handed to the presenter
+    // at vertical blank.
+    FrameQueue::Frame* output_;
+
+    // What the tile viewer last drew for a pattern table.
+    struct TileView {
+        int offset[256];
+        uint32_t version[256];
+        bool dirty[256];
+        int palette;
+        uint32_t palette_version;
+    };
+    int TileMemImage(uint32_t* imgbuf, uint16_t addr, int palette,
+                     uint8_t *prefcolor, TileView* view);
     void DebugVram(bool* active, uint8_t prefcolor[2][256]);
     struct Position { int x, y, nt; };
     Position scrollreg_[262];
     Position last_scrollreg_;
-
-    void BuildExpanderTables();
-    uint32_t normal_table_[256];
-    uint32_t reflection_table_[256];
 };
 
 #endif // EMUDORE_SRC_NES_PPU_H
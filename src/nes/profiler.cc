@@ -0,0 +1,302 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <gflags/gflags.h>
+#include "imgui.h"
+
+#include "proto/profile.pb.h"
+#include "src/nes/profiler.h"
+#include "src/nes/mapper.h"
+
+DEFINE_int32(profile_period, 1000,
+             "CPU cycles between samples in sampling profiler mode.");
+
+Profiler::Profiler(NES* nes)
+  : nes_(nes),
+    mode_(OFF),
+    period_(FLAGS_profile_period),
+    countdown_(FLAGS_profile_period),
+    retired_(0),
+    total_(0),
+    sp_(0xFD) {
+    Reset();
+}
+
+void Profiler::set_mode(Mode mode, int period) {
+    if (period > 0)
+        period_ = period;
+    countdown_ = period_;
+    if (mode_ == OFF) {
+        // The shadow stack is stale after running unprofiled.
+        stack_.resize(1);
+        sp_ = nes_->cpu()->sp();
+        retired_ = nes_->cpu()->retired();
+    }
+    mode_ = mode;
+}
+
+void Profiler::Reset() {
+    nodes_.clear();
+    nodes_.push_back(Node{kRoot, -1, {}});
+    stack_.clear();
+    stack_.push_back(Frame{0, 0xFF});
+    samples_.clear();
+    total_ = 0;
+}
+
+uint32_t Profiler::Location(uint16_t pc) {
+    int offset = nes_->mapper()->PrgOffset(pc);
+    if (offset < 0)
+        return pc;
+    return uint32_t(offset / 0x2000 + 1) << 16 | pc;
+}
+
+std::string Profiler::Name(uint32_t loc) {
+    char buf[16];
+    if (loc == kRoot) {
+        return "[main]";
+    } else if (loc >> 16) {
+        sprintf(buf, "%02x:%04x", (loc >> 16) - 1, loc & 0xFFFF);
+    } else {
+        sprintf(buf, "%04x", loc);
+    }
+    return std::string(buf);
+}
+
+void Profiler::Call(uint16_t target, uint8_t sp) {
+    if (stack_.size() >= kMaxDepth)
+        return;
+    uint32_t func = Location(target);
+    int parent = stack_.back().node;
+    int node;
+    const auto& it = nodes_[parent].children.find(func);
+    if (it == nodes_[parent].children.end()) {
+        node = nodes_.size();
+        nodes_[parent].children[func] = node;
+        nodes_.push_back(Node{func, parent, {}});
+    } else {
+        node = it->second;
+    }
+    stack_.push_back(Frame{node, sp});
+}
+
+void Profiler::Return(uint8_t sp) {
+    // Pop every frame the stack pointer has moved above.  This keeps the
+    // shadow stack in sync when code discards return addresses or uses
+    // RTS as a computed jump.
+    while(stack_.size() > 1 && stack_.back().sp < sp)
+        stack_.pop_back();
+}
+
+std::string Profiler::Stack(int node) {
+    if (node == 0)
+        return Name(kRoot);
+    return Stack(nodes_[node].parent) + ";" + Name(nodes_[node].func);
+}
+
+std::vector<Profiler::Entry> Profiler::Top() {
+    std::map<uint32_t, Entry> funcs;
+    std::vector<uint32_t> seen;
+    for(const auto& s : samples_) {
+        int node = s.first >> 32;
+        auto& self = funcs[nodes_[node].func];
+        self.loc = nodes_[node].func;
+        self.self += s.second;
+        // Inclusive time counts each function once per stack, even
+        // when it recurses.
+        seen.clear();
+        for(; node >= 0; node = nodes_[node].parent) {
+            uint32_t func = nodes_[node].func;
+            if (std::find(seen.begin(), seen.end(), func) != seen.end())
+                continue;
+            seen.push_back(func);
+            auto& e = funcs[func];
+            e.loc = func;
+            e.total += s.second;
+        }
+    }
+    std::vector<Entry> result;
+    for(const auto& f : funcs)
+        result.push_back(f.second);
+    std::sort(result.begin(), result.end(),
+              [](const Entry& a, const Entry& b) { return a.self > b.self; });
+    return result;
+}
+
+bool Profiler::WriteFolded(const std::string& filename) {
+    FILE* fp = fopen(filename.c_str(), "w");
+    if (fp == nullptr)
+        return false;
+    std::map<int, uint64_t> self;
+    for(const auto& s : samples_)
+        self[s.first >> 32] += s.second;
+    for(const auto& s : self) {
+        fprintf(fp, "%s %lu\n", Stack(s.first).c_str(),
+                (unsigned long)s.second);
+    }
+    fclose(fp);
+    return true;
+}
+
+bool Profiler::WritePprof(const std::string& filename) {
+    perftools::profiles::Profile profile;
+    std::map<std::string, int64_t> strings;
+    auto str = [&](const std::string& s) -> int64_t {
+        const auto& it = strings.find(s);
+        if (it != strings.end())
+            return it->second;
+        int64_t id = profile.string_table_size();
+        profile.add_string_table(s);
+        strings[s] = id;
+        return id;
+    };
+    str("");
+
+    auto* type = profile.add_sample_type();
+    type->set_type(str("cycles"));
+    type->set_unit(str("count"));
+    profile.mutable_period_type()->set_type(str("cycles"));
+    profile.mutable_period_type()->set_unit(str("count"));
+    profile.set_period(mode_ == SAMPLE ? period_ : 1);
+
+    std::map<uint32_t, uint64_t> functions;
+    auto function = [&](uint32_t func) -> uint64_t {
+        const auto& it = functions.find(func);
+        if (it != functions.end())
+            return it->second;
+        auto* f = profile.add_function();
+        f->set_id(profile.function_size());
+        f->set_name(str(Name(func)));
+        f->set_start_line(func & 0xFFFF);
+        functions[func] = f->id();
+        return f->id();
+    };
+
+    std::map<std::pair<uint32_t, uint32_t>, uint64_t> locations;
+    auto location = [&](uint32_t func, uint32_t loc) -> uint64_t {
+        const auto key = std::make_pair(func, loc);
+        const auto& it = locations.find(key);
+        if (it != locations.end())
+            return it->second;
+        auto* l = profile.add_location();
+        l->set_id(profile.location_size());
+        l->set_address(loc);
+        auto* line = l->add_line();
+        line->set_function_id(function(func));
+        line->set_line(loc & 0xFFFF);
+        locations[key] = l->id();
+        return l->id();
+    };
+
+    for(const auto& s : samples_) {
+        int node = s.first >> 32;
+        uint32_t loc = s.first & 0xFFFFFFFF;
+        auto* sample = profile.add_sample();
+        sample->add_value(s.second);
+        sample->add_location_id(location(nodes_[node].func, loc));
+        for(node = nodes_[node].parent; node >= 0; node = nodes_[node].parent) {
+            uint32_t func = nodes_[node].func;
+            sample->add_location_id(location(func, func));
+        }
+    }
+
+    std::string data;
+    profile.SerializeToString(&data);
+    FILE* fp = fopen(filename.c_str(), "wb");
+    if (fp == nullptr)
+        return false;
+    fwrite(data.data(), 1, data.size(), fp);
+    fclose(fp);
+    return true;
+}
+
+void Profiler::Command(int argc, char **argv) {
+    DebugConsole* console = nes_->console();
+    if (argc < 2) {
+        console->AddLog("[error] %s: Wrong number of arguments.", argv[0]);
+        console->AddLog("[error] %s <off|sample [period]|exact|reset|top [n]"
+                        "|folded <file>|pprof <file>>", argv[0]);
+        return;
+    }
+    std::string cmd(argv[1]);
+    if (cmd == "off") {
+        set_mode(OFF);
+    } else if (cmd == "sample") {
+        set_mode(SAMPLE, argc == 3 ? strtol(argv[2], 0, 0) : 0);
+    } else if (cmd == "exact") {
+        set_mode(EXACT);
+    } else if (cmd == "reset") {
+        Reset();
+    } else if (cmd == "top") {
+        int n = (argc == 3) ? strtol(argv[2], 0, 0) : 10;
+        auto top = Top();
+        console->AddLog("%-8s %12s %12s", "func", "self", "total");
+        for(int i=0; i<n && i<int(top.size()); i++) {
+            console->AddLog("%-8s %12lu %12lu", Name(top[i].loc).c_str(),
+                    (unsigned long)top[i].self, (unsigned long)top[i].total);
+        }
+    } else if (cmd == "folded" && argc == 3) {
+        if (!WriteFolded(argv[2]))
+            console->AddLog("[error] Could not write %s", argv[2]);
+    } else if (cmd == "pprof" && argc == 3) {
+        if (!WritePprof(argv[2]))
+            console->AddLog("[error] Could not write %s", argv[2]);
+    } else {
+        console->AddLog("[error] %s: Unknown subcommand %s", argv[0], argv[1]);
+    }
+}
+
+void Profiler::DebugStuff(bool* active) {
+    static char filename[256] = "nes.prof";
+
+    if (!*active)
+        return;
+    nes_->Live();
+
+    ImGui::Begin("Profiler", active);
+    int mode = mode_;
+    ImGui::RadioButton("Off", &mode, OFF); ImGui::SameLine();
+    ImGui::RadioButton("Sample", &mode, SAMPLE); ImGui::SameLine();
+    ImGui::RadioButton("Exact", &mode, EXACT);
+    if (mode != mode_)
+        set_mode(Mode(mode));
+    ImGui::SameLine();
+    if (ImGui::Button("Reset"))
+        Reset();
+
+    ImGui::InputText("File", filename, sizeof(filename));
+    if (ImGui::Button("Export folded")) {
+        WriteFolded(filename);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Export pprof")) {
+        WritePprof(filename);
+    }
+
+    ImGui::Text("Total: %lu cycles, %d call paths, depth %d",
+                (unsigned long)total_, int(nodes_.size()),
+                int(stack_.size()));
+    ImGui::Separator();
+
+    auto top = Top();
+    ImGui::BeginChild("functions");
+    ImGui::Columns(5, "profile");
+    ImGui::Text("Function"); ImGui::NextColumn();
+    ImGui::Text("Self"); ImGui::NextColumn();
+    ImGui::Text("Self %%"); ImGui::NextColumn();
+    ImGui::Text("Total"); ImGui::NextColumn();
+    ImGui::Text("Total %%"); ImGui::NextColumn();
+    ImGui::Separator();
+    double scale = total_ ? 100.0 / total_ : 0.0;
+    for(const auto& e : top) {
+        ImGui::Text("%s", Name(e.loc).c_str()); ImGui::NextColumn();
+        ImGui::Text("%lu", (unsigned long)e.self); ImGui::NextColumn();
+        ImGui::Text("%.2f", e.self * scale); ImGui::NextColumn();
+        ImGui::Text("%lu", (unsigned long)e.total); ImGui::NextColumn();
+        ImGui::Text("%.2f", e.total * scale); ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+    ImGui::EndChild();
+    ImGui::End();
+}
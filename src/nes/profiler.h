@@ -0,0 +1,123 @@
+#ifndef EMUDORE_SRC_NES_PROFILER_H
+#define EMUDORE_SRC_NES_PROFILER_H
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "src/cpu2.h"
+#include "src/nes/nes.h"
+
+// Profiles CPU cycles by (PRG bank, PC) and attributes them to call stacks
+// reconstructed from JSR/RTS/BRK/RTI and NMI/IRQ entry.
+//
+// In EXACT mode every instruction's cycles are recorded.  In SAMPLE mode the
+// shadow call stack is still maintained (a single opcode check per
+// instruction), but only one location is recorded every period cycles.
+class Profiler {
+  public:
+    enum Mode {
+        OFF,
+        SAMPLE,
+        EXACT,
+    };
+    Profiler(NES* nes);
+
+    inline Mode mode() const { return mode_; }
+    void set_mode(Mode mode, int period=0);
+    void Reset();
+
+    // Called after each CPU step with the number of cycles it took.
+    inline void Step(int cycles) {
+        if (mode_ == OFF)
+            return;
+        Cpu* cpu = nes_->cpu();
+        bool executed = cpu->retired() != retired_;
+        retired_ = cpu->retired();
+        // The interrupt pushed 3 bytes before the handler's first
+        // instruction ran, so compute its frame from the previous SP.
+        if (executed && cpu->last_interrupt())
+            Call(cpu->last_pc(), sp_ - 3);
+
+        if (mode_ == EXACT) {
+            Record(cpu->last_pc(), cycles);
+        } else {
+            countdown_ -= cycles;
+            if (countdown_ <= 0) {
+                countdown_ += period_;
+                Record(cpu->last_pc(), period_);
+            }
+        }
+        if (executed) {
+            switch(cpu->last_opcode()) {
+            case 0x00:  // BRK
+            case 0x20:  // JSR
+                Call(cpu->pc(), cpu->sp());
+                break;
+            case 0x40:  // RTI
+            case 0x60:  // RTS
+                Return(cpu->sp());
+                break;
+            }
+        }
+        sp_ = cpu->sp();
+    }
+
+    // Writes the profile as folded stacks, one "a;b;c cycles" per line,
+    // for flamegraph.pl and similar tools.
+    bool WriteFolded(const std::string& filename);
+    // Writes the profile as a pprof protobuf.
+    bool WritePprof(const std::string& filename);
+
+    void DebugStuff(bool* active);
+    void Command(int argc, char **argv);
+
+  private:
+    struct Node {
+        uint32_t func;
+        int parent;
+        std::map<uint32_t, int> children;
+    };
+    struct Frame {
+        int node;
+        uint8_t sp;
+    };
+    struct Entry {
+        uint32_t loc;
+        uint64_t self;
+        uint64_t total;
+    };
+
+    // A location packs the 8KiB PRG bank (plus one, zero meaning RAM or
+    // open bus) above the 16-bit CPU address.  kRoot names the bottom of
+    // the call stack.
+    static const uint32_t kRoot = 0xFFFFFFFF;
+    uint32_t Location(uint16_t pc);
+    std::string Name(uint32_t loc);
+    void Call(uint16_t target, uint8_t sp);
+    void Return(uint8_t sp);
+    inline void Record(uint16_t pc, int cycles) {
+        uint64_t key = uint64_t(stack_.back().node) << 32 | Location(pc);
+        samples_[key] += cycles;
+        total_ += cycles;
+    }
+    std::string Stack(int node);
+    std::vector<Entry> Top();
+
+    NES* nes_;
+    Mode mode_;
+    int period_;
+    int countdown_;
+    uint64_t retired_;
+    uint64_t total_;
+    uint8_t sp_;
+
+    static const int kMaxDepth = 128;
+    std::vector<Node> nodes_;
+    std::vector<Frame> stack_;
+    // Cycles keyed by (call tree node << 32 | location).
+    std::unordered_map<uint64_t, uint64_t> samples_;
+};
+
+#endif // EMUDORE_SRC_NES_PROFILER_H
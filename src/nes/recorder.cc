@@ -0,0 +1,284 @@
+#include <chrono>
+#include <cstring>
+
+#include "src/nes/recorder.h"
+
+Recorder::Recorder(NES* nes)
+  : nes_(nes),
+    y4m_(false),
+    palette_version_(0),
+    done_(false),
+    frames_(0),
+    stalls_(0),
+    stall_nanos_(0),
+    max_depth_(0) {}
+
+Recorder::~Recorder() {
+    Stop();
+}
+
+bool Recorder::Open(Output* out, const std::string& filename) {
+    if (filename.empty())
+        return false;
+    if (filename[0] == '|') {
+        out->fp = popen(filename.c_str() + 1, "w");
+        out->pipe = true;
+    } else {
+        out->fp = fopen(filename.c_str(), "wb");
+        out->pipe = false;
+    }
+    out->name = filename;
+    out->bytes = 0;
+    return out->fp != nullptr;
+}
+
+void Recorder::Close(Output* out) {
+    if (!out->fp)
+        return;
+    if (out->pipe)
+        pclose(out->fp);
+    else
+        fclose(out->fp);
+    out->fp = nullptr;
+}
+
+bool Recorder::StartVideo(const std::string& filename) {
+    if (video_.fp)
+        return false;
+    if (!Open(&video_, filename))
+        return false;
+    y4m_ = filename.size() > 4 &&
+           filename.compare(filename.size() - 4, 4, ".y4m") == 0;
+    if (y4m_) {
+        // The NES runs at 39375000/655171 (about 60.0988) fps, with pixels
+        // 8:7 wide.
+        video_.bytes += fprintf(video_.fp, "YUV4MPEG2 W256 H240 "
+                                "F39375000:655171 Ip A8:7 C444\n");
+    }
+    frames_ = 0;
+    StartWriter();
+    return true;
+}
+
+bool Recorder::StartAudio(const std::string& filename) {
+    if (audio_.fp)
+        return false;
+    if (!Open(&audio_, filename))
+        return false;
+    // A pipe can't be rewound to fix up the sizes, so claim the maximum.
+    audio_.bytes += WriteWavHeader(audio_.pipe ? 0xFFFFFFFF - 36 : 0);
+    samples_.clear();
+    StartWriter();
+    return true;
+}
+
+void Recorder::Stop() {
+    if (audio_.fp && !samples_.empty())
+        FlushSamples();
+    StopWriter();
+    if (audio_.fp && !audio_.pipe) {
+        fseek(audio_.fp, 0, SEEK_SET);
+        WriteWavHeader(uint32_t(audio_.bytes - 44));
+    }
+    Close(&video_);
+    Close(&audio_);
+}
+
+void Recorder::StartWriter() {
+    if (writer_.joinable())
+        return;
+    done_ = false;
+    stalls_ = 0;
+    stall_nanos_ = 0;
+    max_depth_ = 0;
+    writer_ = std::thread(&Recorder::Writer, this);
+}
+
+void Recorder::StopWriter() {
+    if (!writer_.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_ = true;
+    }
+    cv_.notify_all();
+    writer_.join();
+}
+
+void Recorder::CaptureFrame(const FrameQueue::Frame& frame) {
+    uint32_t version = nes_->palette_version();
+    if (!palette_ || version != palette_version_) {
+        auto palette = std::make_shared<std::vector<uint32_t>>(8 * 64);
+        for(int e=0; e<8; e++)
+            memcpy(&(*palette)[e * 64], nes_->palette_table(e), 64 * 4);
+        palette_ = palette;
+        palette_version_ = version;
+    }
+    Job job;
+    job.video = true;
+    job.data.reserve(sizeof(frame.picture) + sizeof(frame.emphasis));
+    job.data.assign(frame.picture, frame.picture + sizeof(frame.picture));
+    job.data.insert(job.data.end(), frame.emphasis,
+                    frame.emphasis + sizeof(frame.emphasis));
+    job.palette = palette_;
+    Enqueue(&job);
+    frames_++;
+}
+
+void Recorder::FlushSamples() {
+    Job job;
+    job.video = false;
+    job.data.resize(samples_.size() * 2);
+    for(size_t i=0; i<samples_.size(); i++) {
+        float s = samples_[i] * 32767.0f;
+        int16_t v = s > 32767.0f ? 32767 : s < -32768.0f ? -32768 : int16_t(s);
+        job.data[i * 2 + 0] = uint8_t(v);
+        job.data[i * 2 + 1] = uint8_t(v >> 8);
+    }
+    samples_.clear();
+    Enqueue(&job);
+}
+
+void Recorder::Enqueue(Job* job) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (jobs_.size() >= kMaxJobs) {
+        auto t0 = std::chrono::steady_clock::now();
+        cv_.wait(lock, [this]{ return jobs_.size() < kMaxJobs; });
+        auto t1 = std::chrono::steady_clock::now();
+        stalls_++;
+        stall_nanos_ += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                t1 - t0).count();
+    }
+    jobs_.push_back(std::move(*job));
+    if (jobs_.size() > max_depth_)
+        max_depth_ = jobs_.size();
+    lock.unlock();
+    cv_.notify_all();
+}
+
+void Recorder::Writer() {
+    for(;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]{ return !jobs_.empty() || done_; });
+            if (jobs_.empty())
+                break;
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+        cv_.notify_all();
+        if (job.video)
+            WriteFrame(job);
+        else
+            WriteSamples(job);
+    }
+    if (video_.fp)
+        fflush(video_.fp);
+    if (audio_.fp)
+        fflush(audio_.fp);
+}
+
+void Recorder::WriteFrame(const Job& job) {
+    static const int kPixels = 256 * 240;
+    const uint8_t* index = job.data.data();
+    const uint8_t* emphasis = index + kPixels;
+    const uint32_t* palette = job.palette->data();
+    std::vector<uint8_t> buf(kPixels * 3);
+
+    for(int y=0; y<240; y++) {
+        const uint32_t* pal = palette + (emphasis[y] % 8) * 64;
+        for(int x=0; x<256; x++) {
+            int i = y * 256 + x;
+            uint32_t p = pal[index[i] % 64];
+            int r = p & 0xFF, g = (p >> 8) & 0xFF, b = (p >> 16) & 0xFF;
+            if (y4m_) {
+                // BT.601, studio range, one plane after another.  The
+                // coefficients are 16.16 fixed point.
+                buf[i] = (16829 * r + 33039 * g + 6416 * b +
+                          (16 << 16) + 32768) >> 16;
+                buf[kPixels + i] = (-9714 * r - 19070 * g + 28784 * b +
+                                    (128 << 16) + 32768) >> 16;
+                buf[2 * kPixels + i] = (28784 * r - 24103 * g - 4681 * b +
+                                        (128 << 16) + 32768) >> 16;
+            } else {
+                buf[i * 3 + 0] = r;
+                buf[i * 3 + 1] = g;
+                buf[i * 3 + 2] = b;
+            }
+        }
+    }
+    if (y4m_)
+        video_.bytes += fwrite("FRAME\n", 1, 6, video_.fp);
+    video_.bytes += fwrite(buf.data(), 1, buf.size(), video_.fp);
+}
+
+void Recorder::WriteSamples(const Job& job) {
+    audio_.bytes += fwrite(job.data.data(), 1, job.data.size(), audio_.fp);
+}
+
+size_t Recorder::WriteWavHeader(uint32_t data_bytes) {
+    static const uint32_t kRate = 44100;
+    uint8_t h[44];
+    auto le16 = [&h](int at, uint16_t v) {
+        h[at] = uint8_t(v); h[at + 1] = uint8_t(v >> 8);
+    };
+    auto le32 = [&h](int at, uint32_t v) {
+        for(int i=0; i<4; i++)
+            h[at + i] = uint8_t(v >> (i * 8));
+    };
+    memcpy(h + 0, "RIFF", 4);
+    le32(4, data_bytes + 36);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    le32(16, 16);               // fmt chunk size
+    le16(20, 1);                // PCM
+    le16(22, 1);                // mono
+    le32(24, kRate);
+    le32(28, kRate * 2);        // bytes per second
+    le16(32, 2);                // bytes per frame
+    le16(34, 16);               // bits per sample
+    memcpy(h + 36, "data", 4);
+    le32(40, data_bytes);
+    return fwrite(h, 1, sizeof(h), audio_.fp);
+}
+
+void Recorder::Command(int argc, char **argv) {
+    DebugConsole* console = nes_->console();
+    if (argc < 2) {
+        console->AddLog("[error] %s: Wrong number of arguments.", argv[0]);
+        console->AddLog("[error] %s <video <file>|audio <file>|stop|stats>",
+                        argv[0]);
+        return;
+    }
+    std::string cmd(argv[1]);
+    if (cmd == "video" && argc == 3) {
+        if (!StartVideo(argv[2]))
+            console->AddLog("[error] Could not capture video to %s", argv[2]);
+    } else if (cmd == "audio" && argc == 3) {
+        if (!StartAudio(argv[2]))
+            console->AddLog("[error] Could not capture audio to %s", argv[2]);
+    } else if (cmd == "stop") {
+        Stop();
+    } else if (cmd == "stats") {
+        size_t depth;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            depth = jobs_.size();
+        }
+        if (video_.fp)
+            console->AddLog("Video %s: %lu frames, %lu bytes",
+                            video_.name.c_str(), (unsigned long)frames_,
+                            (unsigned long)video_.bytes.load(
+                                    std::memory_order_relaxed));
+        if (audio_.fp)
+            console->AddLog("Audio %s: %lu bytes", audio_.name.c_str(),
+                            (unsigned long)audio_.bytes.load(
+                                    std::memory_order_relaxed));
+        console->AddLog("Queue %lu/%lu (max %lu), %lu stalls, %.3f s stalled",
+                        (unsigned long)depth, (unsigned long)kMaxJobs,
+                        (unsigned long)max_depth_, (unsigned long)stalls_,
+                        stall_nanos_ / 1e9);
+    } else {
+        console->AddLog("[error] %s: Unknown subcommand %s", argv[0], argv[1]);
+    }
+}
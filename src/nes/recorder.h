@@ -0,0 +1,103 @@
+#ifndef EMUDORE_SRC_NES_RECORDER_H
+#define EMUDORE_SRC_NES_RECORDER_H
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/nes/frame_queue.h"
+#include "src/nes/nes.h"
+
+// Captures every emulated frame and audio sample for offline encoding.
+//
+// Video is written as raw 24-bit RGB, or as YUV4MPEG2 (4:4:4) when the
+// name ends in .y4m; audio as 16-bit mono WAV.  A name starting with '|'
+// is run as a command and fed through a pipe, e.g. "|ffmpeg -i - out.mp4".
+//
+// The emulation thread only copies palette indices and samples into a
+// bounded queue; a writer thread converts and writes them.  When the
+// writer falls behind, the emulator waits for it, and the stall count and
+// time are reported by "capture stats".  Capture runs on the emulation
+// thread, so it doesn't depend on the screen being presented.
+class Recorder {
+  public:
+    Recorder(NES* nes);
+    ~Recorder();
+
+    bool StartVideo(const std::string& filename);
+    bool StartAudio(const std::string& filename);
+    void Stop();
+    inline bool video() const { return video_.fp != nullptr; }
+
+    // Called for each finished frame and each audio sample.
+    inline void Frame(const FrameQueue::Frame& frame) {
+        if (video_.fp)
+            CaptureFrame(frame);
+    }
+    inline void Sample(float sample) {
+        if (audio_.fp) {
+            samples_.push_back(sample);
+            if (samples_.size() == kAudioChunk)
+                FlushSamples();
+        }
+    }
+
+    void Command(int argc, char **argv);
+
+  private:
+    static const size_t kAudioChunk = 4096;
+    static const size_t kMaxJobs = 32;
+
+    struct Output {
+        FILE* fp = nullptr;
+        bool pipe = false;
+        std::string name;
+        // Counted by the writer thread and read by "capture stats".
+        std::atomic<uint64_t> bytes{0};
+    };
+    struct Job {
+        bool video;
+        std::vector<uint8_t> data;
+        // Host palette for each emphasis setting, for video jobs.
+        std::shared_ptr<const std::vector<uint32_t>> palette;
+    };
+
+    static bool Open(Output* out, const std::string& filename);
+    static void Close(Output* out);
+    void CaptureFrame(const FrameQueue::Frame& frame);
+    void FlushSamples();
+    void Enqueue(Job* job);
+    void Writer();
+    void WriteFrame(const Job& job);
+    void WriteSamples(const Job& job);
+    size_t WriteWavHeader(uint32_t data_bytes);
+    void StartWriter();
+    void StopWriter();
+
+    NES* nes_;
+    Output video_;
+    Output audio_;
+    bool y4m_;
+    std::vector<float> samples_;
+    std::shared_ptr<const std::vector<uint32_t>> palette_;
+    uint32_t palette_version_;
+
+    std::thread writer_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Job> jobs_;
+    bool done_;
+
+    uint64_t frames_;
+    uint64_t stalls_;
+    uint64_t stall_nanos_;
+    size_t max_depth_;
+};
+
+#endif // EMUDORE_SRC_NES_RECORDER_H
@@ -0,0 +1,45 @@
+#ifndef EMUDORE_SRC_NES_SPSC_QUEUE_H
+#define EMUDORE_SRC_NES_SPSC_QUEUE_H
+#include <atomic>
+#include <cstdint>
+
+// A bounded, lock-free queue with one producer thread and one consumer
+// thread.  N must be a power of two.
+template<typename T, uint32_t N>
+class SpscQueue {
+  public:
+    SpscQueue() : head_(0), tail_(0) {}
+
+    // Returns false if the queue is full.
+    bool Push(const T& item) {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == N)
+            return false;
+        items_[tail % N] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Returns false if the queue is empty.
+    bool Pop(T* item) {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire))
+            return false;
+        *item = items_[head % N];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    uint32_t size() const {
+        return tail_.load(std::memory_order_acquire) -
+               head_.load(std::memory_order_acquire);
+    }
+
+  private:
+    static_assert((N & (N - 1)) == 0, "N must be a power of two");
+    T items_[N];
+    std::atomic<uint32_t> head_;
+    std::atomic<uint32_t> tail_;
+};
+
+#endif // EMUDORE_SRC_NES_SPSC_QUEUE_H
@@ -0,0 +1,49 @@
+#include "src/nes/tile_cache.h"
+
+uint32_t TileCache::normal_[256];
+uint32_t TileCache::flipped_[256];
+
+TileCache::TileCache()
+  : chr_(nullptr),
+    counter_(0) {
+    BuildExpanderTables();
+}
+
+void TileCache::BuildExpanderTables() {
+    // Precompute expanded 8-bit patterns into 32-bits to we can build the
+    // pattern+attribute words later without any loops.
+    uint8_t val;
+    for(int n=0; n<256; n++) {
+        uint32_t data = 0;
+        val = n;
+        for(int bit=0; bit<8; bit++) {
+            data = (data<<4) | (val & 0x80)>>7;
+            val <<= 1;
+        }
+        normal_[n] = data;
+
+        val = n;
+        for(int bit=0; bit<8; bit++) {
+            data = (data<<4) | (val & 1);
+            val >>= 1;
+        }
+        flipped_[n] = data;
+    }
+}
+
+void TileCache::Reset(const uint8_t* chr, uint32_t chrlen) {
+    chr_ = chr;
+    rows_.assign(chrlen, 0);
+    valid_.assign(chrlen / 16, false);
+    version_.assign(chrlen / 16, ++counter_);
+}
+
+void TileCache::Decode(uint32_t tile) {
+    const uint8_t* data = chr_ + tile * 16;
+    uint32_t* rows = &rows_[tile * 16];
+    for(int row=0; row<8; row++) {
+        rows[row * 2 + 0] = Expand(data[row], data[row + 8], false);
+        rows[row * 2 + 1] = Expand(data[row], data[row + 8], true);
+    }
+    valid_[tile] = true;
+}
@@ -0,0 +1,58 @@
+#ifndef EMUDORE_SRC_NES_TILE_CACHE_H
+#define EMUDORE_SRC_NES_TILE_CACHE_H
+#include <cstdint>
+#include <vector>
+
+// Pre-expanded CHR tiles, indexed by CHR offset.
+//
+// Each tile row is stored as a 32-bit word with one nybble per pixel, the
+// leftmost pixel in the top nybble, holding the pixel's 2-bit color; the
+// PPU ORs the attribute bits into the other two bits of each nybble.  Both
+// the normal and horizontally flipped rows are kept.  Tiles are decoded on
+// first use and invalidated by writes to CHR RAM.  Each tile also has a
+// version, bumped when it is invalidated, so viewers can tell which tiles
+// changed.
+class TileCache {
+  public:
+    TileCache();
+
+    void Reset(const uint8_t* chr, uint32_t chrlen);
+    inline void Invalidate(uint32_t offset) {
+        valid_[offset / 16] = false;
+        version_[offset / 16] = ++counter_;
+    }
+    inline uint32_t version(uint32_t offset) const {
+        return version_[offset / 16];
+    }
+
+    // Returns the expanded row for the low plane byte at CHR offset.
+    inline uint32_t Row(uint32_t offset, bool flip) {
+        uint32_t tile = offset / 16;
+        if (!valid_[tile])
+            Decode(tile);
+        return rows_[tile * 16 + (offset % 8) * 2 + flip];
+    }
+
+    // Expands a pair of plane bytes without the cache.
+    static inline uint32_t Expand(uint8_t lo, uint8_t hi, bool flip) {
+        const uint32_t* table = flip ? flipped_ : normal_;
+        return table[lo] | table[hi] << 1;
+    }
+
+  private:
+    void Decode(uint32_t tile);
+    static void BuildExpanderTables();
+
+    const uint8_t* chr_;
+    std::vector<uint32_t> rows_;
+    std::vector<bool> valid_;
+    std::vector<uint32_t> version_;
+    uint32_t counter_;
+
+    // 8 bit abcdefgh -> 000a000b000c000d000e000f000g000h (normal_)
+    //                -> 000h000g000f000e000d000c000b000a (flipped_)
+    static uint32_t normal_[256];
+    static uint32_t flipped_[256];
+};
+
+#endif // EMUDORE_SRC_NES_TILE_CACHE_H
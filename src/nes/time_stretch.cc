@@ -0,0 +1,75 @@
+#include <algorithm>
+#include <cmath>
+
+#include "src/nes/time_stretch.h"
+
+TimeStretch::TimeStretch()
+  : ratio_(1),
+    pos_(kSearch),
+    tail_(kOverlap) {
+    input_.reserve(4 * kSegment * 8);
+    output_.reserve(kSegment);
+}
+
+void TimeStretch::set_ratio(int ratio) {
+    if (ratio != ratio_) {
+        ratio_ = ratio;
+        Reset();
+    }
+}
+
+void TimeStretch::Reset() {
+    input_.clear();
+    pos_ = kSearch;
+    tail_.assign(kOverlap, 0.0f);
+    output_.clear();
+}
+
+bool TimeStretch::Put(float sample) {
+    input_.push_back(sample);
+    if (int(input_.size()) < pos_ + kSearch + kSegment)
+        return false;
+    Process();
+    return true;
+}
+
+int TimeStretch::BestOffset(const float* ref, const float* in) {
+    // Normalized cross-correlation against the previous segment's tail,
+    // checking every other sample to halve the cost.
+    int best = 0;
+    float best_score = -1e30f;
+    for(int d=-kSearch; d<=kSearch; d++) {
+        const float* p = in + d;
+        float corr = 0, energy = 1e-9f;
+        for(int i=0; i<kOverlap; i+=2) {
+            corr += ref[i] * p[i];
+            energy += p[i] * p[i];
+        }
+        float score = corr / std::sqrt(energy);
+        if (score > best_score) {
+            best_score = score;
+            best = d;
+        }
+    }
+    return best;
+}
+
+void TimeStretch::Process() {
+    const float* seg = &input_[pos_];
+    seg += BestOffset(tail_.data(), seg);
+
+    output_.clear();
+    for(int i=0; i<kOverlap; i++) {
+        float w = float(i) / kOverlap;
+        output_.push_back(tail_[i] * (1.0f - w) + seg[i] * w);
+    }
+    for(int i=kOverlap; i<kSegment - kOverlap; i++)
+        output_.push_back(seg[i]);
+    tail_.assign(seg + kSegment - kOverlap, seg + kSegment);
+
+    // Every block of output advances the input ratio_ times as far.
+    pos_ += (kSegment - kOverlap) * ratio_;
+    int drop = std::min(pos_ - kSearch, int(input_.size()));
+    input_.erase(input_.begin(), input_.begin() + drop);
+    pos_ -= drop;
+}
@@ -0,0 +1,40 @@
+#ifndef EMUDORE_SRC_NES_TIME_STRETCH_H
+#define EMUDORE_SRC_NES_TIME_STRETCH_H
+#include <vector>
+
+// Speeds audio up without changing its pitch (WSOLA).
+//
+// The input is cut into overlapping segments, each starting `ratio` times
+// further along than the output has advanced.  Each segment's start is
+// moved by up to kSearch samples to the position that best matches the end
+// of the previous segment, then the two are cross-faded.  Dropping whole
+// periods this way, rather than samples, keeps the pitch.
+class TimeStretch {
+  public:
+    TimeStretch();
+
+    void set_ratio(int ratio);
+    void Reset();
+
+    // Adds an input sample.  Returns true when a new block of output is
+    // ready in output().
+    bool Put(float sample);
+    inline const std::vector<float>& output() const { return output_; }
+
+  private:
+    static const int kSegment = 1024;
+    static const int kOverlap = 256;
+    static const int kSearch = 256;
+
+    void Process();
+    int BestOffset(const float* ref, const float* in);
+
+    int ratio_;
+    std::vector<float> input_;
+    // Nominal start of the next segment in input_.
+    int pos_;
+    std::vector<float> tail_;
+    std::vector<float> output_;
+};
+
+#endif // EMUDORE_SRC_NES_TIME_STRETCH_H
@@ -0,0 +1,278 @@
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+
+#include "src/nes/tracer.h"
+#include "src/nes/mapper.h"
+#include "src/nes/mem.h"
+#include "src/nes/ppu.h"
+
+Tracer::Tracer(NES* nes)
+  : nes_(nes),
+    running_(false),
+    pending_(false),
+    retired_(0),
+    fp_(nullptr),
+    pipe_(false),
+    head_(0),
+    tail_(0),
+    done_(false),
+    records_(0),
+    stalls_(0),
+    frames_{0, INT_MAX},
+    scanlines_{0, INT_MAX} {}
+
+Tracer::~Tracer() {
+    Stop();
+}
+
+bool Tracer::Start(const std::string& filename) {
+    Stop();
+    auto ends_with = [&filename](const std::string& ext) {
+        return filename.size() > ext.size() &&
+               filename.compare(filename.size() - ext.size(),
+                                ext.size(), ext) == 0;
+    };
+    std::string compressor;
+    if (ends_with(".gz"))
+        compressor = "gzip -1";
+    else if (ends_with(".zst"))
+        compressor = "zstd -q";
+
+    if (compressor.empty()) {
+        fp_ = fopen(filename.c_str(), "w");
+        pipe_ = false;
+    } else {
+        if (filename.find('\'') != std::string::npos)
+            return false;
+        std::string cmd = compressor + " > '" + filename + "'";
+        fp_ = popen(cmd.c_str(), "w");
+        pipe_ = true;
+    }
+    if (fp_ == nullptr)
+        return false;
+
+    queue_.resize(kQueueSize);
+    head_ = 0;
+    tail_ = 0;
+    done_ = false;
+    records_ = 0;
+    stalls_ = 0;
+    writer_ = std::thread(&Tracer::Writer, this);
+    running_ = true;
+    return true;
+}
+
+void Tracer::Stop() {
+    if (!running_)
+        return;
+    running_ = false;
+    pending_ = false;
+    done_ = true;
+    writer_.join();
+    if (pipe_)
+        pclose(fp_);
+    else
+        fclose(fp_);
+    fp_ = nullptr;
+}
+
+bool Tracer::Filter(uint16_t pc, int bank, int scanline, uint32_t frame) {
+    if (frame < uint32_t(frames_.lo) || frame > uint32_t(frames_.hi))
+        return false;
+    if (scanline < scanlines_.lo || scanline > scanlines_.hi)
+        return false;
+    if (banks_.any() && (bank < 0 || !banks_[bank]))
+        return false;
+    if (pcs_.empty())
+        return true;
+    for(const auto& r : pcs_) {
+        if (pc >= r.lo && pc <= r.hi)
+            return true;
+    }
+    return false;
+}
+
+void Tracer::Fill(Record* r, uint16_t pc) {
+    Mem* mem = nes_->memory();
+    int offset = nes_->mapper()->PrgOffset(pc);
+    r->pc = pc;
+    r->bank = offset < 0 ? -1 : offset / 0x2000;
+    r->op[0] = mem->read_byte_no_io(pc);
+    r->op[1] = mem->read_byte_no_io(pc + 1);
+    r->op[2] = mem->read_byte_no_io(pc + 2);
+}
+
+void Tracer::CaptureRecord() {
+    Cpu* cpu = nes_->cpu();
+    PPU* ppu = nes_->ppu();
+    uint16_t pc = cpu->pc();
+    int scanline = ppu->scanline();
+    uint32_t frame = nes_->frame();
+    int bank = -1;
+    if (banks_.any()) {
+        int offset = nes_->mapper()->PrgOffset(pc);
+        bank = offset < 0 ? -1 : offset / 0x2000;
+    }
+    if (!Filter(pc, bank, scanline, frame))
+        return;
+
+    // Wait for the writer rather than drop records.
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    while(tail - head_.load(std::memory_order_acquire) >= kQueueSize) {
+        stalls_++;
+        std::this_thread::yield();
+    }
+    Record* r = &queue_[tail % kQueueSize];
+    Fill(r, pc);
+    r->cycles = cpu->cycles64();
+    r->frame = frame;
+    r->interrupt = 0;
+    r->scanline = scanline;
+    r->dot = ppu->cycle();
+    r->a = cpu->a();
+    r->x = cpu->x();
+    r->y = cpu->y();
+    r->sp = cpu->sp();
+    r->p = cpu->p();
+    retired_ = cpu->retired();
+    pending_ = true;
+}
+
+void Tracer::CommitRecord() {
+    pending_ = false;
+    Cpu* cpu = nes_->cpu();
+    // A DMA stall executes nothing.
+    if (cpu->retired() == retired_)
+        return;
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (cpu->last_interrupt()) {
+        // The instruction that ran was the first one of the handler.  Show
+        // the registers as they were when it started: the interrupt pushed
+        // PC and P, set I and took 7 cycles.  The scanline and dot stay
+        // where the interrupt was taken.
+        Record* r = &queue_[tail % kQueueSize];
+        r->interrupt = cpu->last_interrupt();
+        Fill(r, cpu->last_pc());
+        r->cycles += 7;
+        r->sp -= 3;
+        r->p |= 0x04;
+    }
+    tail_.store(tail + 1, std::memory_order_release);
+    records_++;
+}
+
+int Tracer::Format(char* buf, const Record& r) {
+    char *b = buf;
+    switch(r.interrupt) {
+    case 0: break;
+    case 0xFFFA: b += sprintf(b, "---- NMI\n"); break;
+    case 0xFFFC: b += sprintf(b, "---- RESET\n"); break;
+    default: b += sprintf(b, "---- IRQ\n"); break;
+    }
+
+    if (r.bank < 0)
+        b += sprintf(b, "--:%04x  ", r.pc);
+    else
+        b += sprintf(b, "%02x:%04x  ", r.bank, r.pc);
+
+    Cpu::InstructionInfo info = Cpu::info(r.op[0]);
+    uint16_t operand = r.op[1];
+    char inst[24];
+    switch(info.size) {
+    case 0:
+    case 1:
+        b += sprintf(b, "%02x        ", r.op[0]);
+        break;
+    case 2:
+        b += sprintf(b, "%02x %02x     ", r.op[0], r.op[1]);
+        break;
+    case 3:
+        operand |= r.op[2] << 8;
+        b += sprintf(b, "%02x %02x %02x  ", r.op[0], r.op[1], r.op[2]);
+        break;
+    }
+    if (info.mode == Cpu::Relative) {
+        sprintf(inst, "%.3s $%04x", Cpu::instruction_name(r.op[0]),
+                uint16_t(r.pc + 2 + int8_t(operand)));
+    } else {
+        snprintf(inst, sizeof(inst), Cpu::instruction_name(r.op[0]), operand);
+    }
+    b += sprintf(b, "%-14s A:%02x X:%02x Y:%02x P:%02x SP:%02x "
+                 "CYC:%lu SL:%d DOT:%d F:%u\n",
+                 inst, r.a, r.x, r.y, r.p, r.sp,
+                 (unsigned long)r.cycles, r.scanline, r.dot, r.frame);
+    return b - buf;
+}
+
+void Tracer::Writer() {
+    static const int kBufSize = 1 << 16;
+    static const int kMaxLine = 160;
+    std::vector<char> buf(kBufSize);
+    for(;;) {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        uint32_t tail = tail_.load(std::memory_order_acquire);
+        if (head == tail) {
+            if (done_)
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        int len = 0;
+        while(head != tail && len < kBufSize - kMaxLine) {
+            len += Format(&buf[len], queue_[head % kQueueSize]);
+            head++;
+        }
+        head_.store(head, std::memory_order_release);
+        fwrite(buf.data(), 1, len, fp_);
+    }
+    fflush(fp_);
+}
+
+void Tracer::Command(int argc, char **argv) {
+    DebugConsole* console = nes_->console();
+    if (argc < 2) {
+        console->AddLog("[error] %s: Wrong number of arguments.", argv[0]);
+        console->AddLog("[error] %s <start <file>|stop|pc <lo> <hi>|bank <n>"
+                        "|frames <first> <last>|scanlines <first> <last>"
+                        "|clear|stats>", argv[0]);
+        return;
+    }
+    std::string cmd(argv[1]);
+    if (cmd == "start" && argc == 3) {
+        if (!Start(argv[2]))
+            console->AddLog("[error] Could not write %s", argv[2]);
+    } else if (cmd == "stop") {
+        Stop();
+    } else if (cmd == "pc" && argc == 4) {
+        pcs_.push_back(Range{int(strtoul(argv[2], 0, 16)),
+                             int(strtoul(argv[3], 0, 16))});
+    } else if (cmd == "bank" && argc == 3) {
+        banks_.set(strtoul(argv[2], 0, 16) % banks_.size());
+    } else if (cmd == "frames" && argc == 4) {
+        frames_ = Range{int(strtoul(argv[2], 0, 0)),
+                        int(strtoul(argv[3], 0, 0))};
+    } else if (cmd == "scanlines" && argc == 4) {
+        scanlines_ = Range{int(strtoul(argv[2], 0, 0)),
+                           int(strtoul(argv[3], 0, 0))};
+    } else if (cmd == "clear") {
+        pcs_.clear();
+        banks_.reset();
+        frames_ = Range{0, INT_MAX};
+        scanlines_ = Range{0, INT_MAX};
+    } else if (cmd == "stats") {
+        console->AddLog("Trace %s: %lu records, %lu stalls",
+                        running_ ? "running" : "stopped",
+                        (unsigned long)records_, (unsigned long)stalls_);
+        for(const auto& r : pcs_)
+            console->AddLog("  pc %04x-%04x", r.lo, r.hi);
+        for(size_t i=0; i<banks_.size(); i++) {
+            if (banks_[i])
+                console->AddLog("  bank %02x", int(i));
+        }
+        console->AddLog("  frames %d-%d, scanlines %d-%d",
+                        frames_.lo, frames_.hi, scanlines_.lo, scanlines_.hi);
+    } else {
+        console->AddLog("[error] %s: Unknown subcommand %s", argv[0], argv[1]);
+    }
+}
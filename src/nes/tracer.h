@@ -0,0 +1,88 @@
+#ifndef EMUDORE_SRC_NES_TRACER_H
+#define EMUDORE_SRC_NES_TRACER_H
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/cpu2.h"
+#include "src/nes/nes.h"
+
+// Streams an instruction trace to a file.
+//
+// The emulation thread fills compact binary records into a bounded
+// single-producer/single-consumer ring; a writer thread formats them and
+// writes the file, so the emulator never calls sprintf or blocks on I/O
+// unless the writer falls a full ring behind.  Filters on PC, PRG bank,
+// frame and scanline are applied before a record is captured.  Files named
+// *.gz or *.zst are compressed by piping through gzip or zstd.
+class Tracer {
+  public:
+    Tracer(NES* nes);
+    ~Tracer();
+
+    bool Start(const std::string& filename);
+    void Stop();
+    inline bool running() const { return running_; }
+
+    // Called around each CPU step: Capture() before, Commit() after.
+    inline void Capture() {
+        if (running_)
+            CaptureRecord();
+    }
+    inline void Commit() {
+        if (pending_)
+            CommitRecord();
+    }
+
+    void Command(int argc, char **argv);
+
+  private:
+    struct Record {
+        uint64_t cycles;
+        uint32_t frame;
+        uint16_t pc;
+        uint16_t interrupt;
+        int16_t scanline;
+        int16_t dot;
+        int16_t bank;
+        uint8_t a, x, y, sp, p;
+        uint8_t op[3];
+    };
+    struct Range {
+        int lo, hi;
+    };
+    static const uint32_t kQueueSize = 1 << 16;
+
+    void CaptureRecord();
+    void CommitRecord();
+    bool Filter(uint16_t pc, int bank, int scanline, uint32_t frame);
+    void Fill(Record* r, uint16_t pc);
+    void Writer();
+    int Format(char* buf, const Record& r);
+
+    NES* nes_;
+    bool running_;
+    bool pending_;
+    uint64_t retired_;
+    FILE* fp_;
+    bool pipe_;
+    std::thread writer_;
+
+    std::vector<Record> queue_;
+    std::atomic<uint32_t> head_;        // Next record to write.
+    std::atomic<uint32_t> tail_;        // Next record to fill.
+    std::atomic<bool> done_;
+    uint64_t records_;
+    uint64_t stalls_;
+
+    std::vector<Range> pcs_;
+    std::bitset<256> banks_;
+    Range frames_;
+    Range scanlines_;
+};
+
+#endif // EMUDORE_SRC_NES_TRACER_H
@@ -0,0 +1,122 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <gflags/gflags.h>
+
+#include "src/nes/mapper.h"
+#include "src/nes/mem.h"
+#include "src/nes/nes.h"
+#include "src/nes/ppu.h"
+
+DECLARE_string(nsf_wav);
+
+// Counts the A12 rises the PPU reports, by dot.
+class A12Counter : public Mapper {
+  public:
+    A12Counter(NES* nes) : Mapper(nes) { watch_a12_ = true; }
+    uint8_t Read(uint16_t addr) override { return 0; }
+    void Write(uint16_t addr, uint8_t val) override {}
+    void RiseA12() override { rises[nes_->ppu()->cycle()]++; }
+
+    std::map<int, int> rises;
+};
+
+// Not a real mapper number, so no ROM will ever ask for it.
+static const int kMapper = 255;
+REGISTER_MAPPER(kMapper, A12Counter);
+
+static std::string WriteRom() {
+    const char* dir = getenv("TEST_TMPDIR");
+    std::string name = std::string(dir ? dir : "/tmp") + "/test_a12.nes";
+    uint8_t header[16] = {'N', 'E', 'S', 0x1A, 2, 1,
+                          (kMapper & 0xF) << 4, kMapper & 0xF0};
+    static uint8_t rom[2 * 16384 + 8192];
+    FILE* fp = fopen(name.c_str(), "wb");
+    if (!fp || fwrite(header, sizeof(header), 1, fp) != 1 ||
+        fwrite(rom, sizeof(rom), 1, fp) != 1) {
+        fprintf(stderr, "Couldn't write %s.\n", name.c_str());
+        exit(1);
+    }
+    fclose(fp);
+    return name;
+}
+
+static void EmulateFrame(NES* nes) {
+    PPU* ppu = nes->ppu();
+    uint64_t frame = ppu->frame();
+    while(ppu->frame() == frame)
+        ppu->Emulate();
+}
+
+// Renders a frame with the given $2000 value and |sprites| 8x16 sprites on
+// lines 51-66, alternating between the two pattern tables.  Returns the
+// rises in the frame after that, by dot.
+static std::map<int, int> Count(NES* nes, uint8_t ctrl, int sprites) {
+    Mem* mem = nes->memory();
+    mem->write_byte(0x2003, 0);
+    for(int i=0; i<64; i++) {
+        bool on = i < sprites;
+        mem->write_byte(0x2004, on ? 50 : 0xF0);
+        mem->write_byte(0x2004, on ? i & 1 : 0);
+        mem->write_byte(0x2004, 0);
+        mem->write_byte(0x2004, on ? i * 8 : 0);
+    }
+    mem->write_byte(0x2000, ctrl);
+    mem->write_byte(0x2001, 0x18);
+    EmulateFrame(nes);
+
+    A12Counter* counter = static_cast<A12Counter*>(nes->mapper());
+    counter->rises.clear();
+    EmulateFrame(nes);
+    return counter->rises;
+}
+
+// Checks the A12 rises a frame gives an MMC3 for each pattern table layout.
+int main(int argc, char *argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    // Keeps the NES from opening a window or an audio device.
+    FLAGS_nsf_wav = "unused.wav";
+    NES nes;
+    nes.LoadFile(WriteRom());
+    nes.Reset();
+
+    static const struct {
+        const char* layout;
+        uint8_t ctrl;
+        int sprites;
+        std::map<int, int> rises;
+    } tests[] = {
+        // One rise per rendered line as sprite fetches start, and none
+        // between the background fetches of one line and the next.
+        { "background $0000, sprites $1000", 0x08, 0, {{261, 241}} },
+        // The rise comes with the next line's background, plus one when
+        // the pre-render line starts fetching after vertical blank.
+        { "background $1000, sprites $0000", 0x10, 0, {{5, 1}, {325, 241}} },
+        { "both $1000", 0x18, 0, {{5, 1}} },
+        { "both $0000", 0x00, 0, {} },
+        // 8x16 sprites from both tables rise at each $1000 slot.  Empty
+        // slots fetch tile $FF, which is in $1000 too.
+        { "8x16 sprites from both tables", 0x20, 8,
+          {{261, 225}, {269, 16}, {285, 16}, {301, 16}, {317, 16}} },
+    };
+
+    int failed = 0;
+    for(const auto& t : tests) {
+        std::map<int, int> rises = Count(&nes, t.ctrl, t.sprites);
+        if (rises == t.rises)
+            continue;
+        printf("FAIL: %s:", t.layout);
+        for(const auto& r : rises)
+            printf(" dot %d x%d", r.first, r.second);
+        printf("\n");
+        failed++;
+    }
+    if (failed) {
+        printf("%d failed\n", failed);
+        return 1;
+    }
+    printf("SUCCESS!\n");
+    return 0;
+}
@@ -2,14 +2,14 @@
 #include <cstdio>
 #include <gflags/gflags.h>
 
-#include "src/cpu2.h"
+#include "src/cpu6502.h"
 #include "src/memory.h"
 
 DEFINE_int32(end, 0, "End address");
 
-class Mem: public Memory {
+class TestMem final : public Memory {
   public:
-    Mem() {}
+    TestMem() {}
 
     uint8_t read_byte(uint16_t addr) override { return ram_[addr]; }
     void write_byte(uint16_t addr, uint8_t val) override { ram_[addr] = val; }
@@ -41,8 +41,8 @@ class Mem: public Memory {
 
 int main(int argc, char *argv[]) {
     gflags::ParseCommandLineFlags(&argc, &argv, true);
-    Mem mem;
-    Cpu cpu(&mem);
+    TestMem mem;
+    Cpu6502<TestMem, Ricoh2A03> cpu(&mem);
 
     mem.Load(argv[1], 0x400);
     cpu.set_pc(0x400);
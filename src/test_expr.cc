@@ -0,0 +1,96 @@
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <gflags/gflags.h>
+
+#include "src/nes/expr.h"
+#include "src/nes/mem.h"
+#include "src/nes/nes.h"
+
+DECLARE_string(nsf_wav);
+
+// Checks the breakpoint condition compiler: precedence, the results of the
+// short-circuit operators and the columns errors are reported at.
+int main(int argc, char *argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    // Keeps the NES from opening a window or an audio device.
+    FLAGS_nsf_wav = "unused.wav";
+    NES nes;
+    nes.memory()->write_byte(0x10, 0x42);
+
+    static const struct {
+        const char* text;
+        int32_t result;
+    } values[] = {
+        { "1+2*3", 7 },
+        { "(1+2)*3", 9 },
+        { "1<<4|1", 17 },
+        { "1 | 2 ^ 3 & 6", 1 },
+        { "2+3 == 5 && 7 > 6", 1 },
+        { "-1+~0", -2 },
+        { "!0 + !5", 1 },
+        { "10 % 4 * 3", 6 },
+        { "10/0", 0 },
+        { "[$10] == $42", 1 },
+        { "addr == $2000 && val == 9", 1 },
+        // && and || give 0 or 1, and || binds looser than &&.
+        { "5 && 7", 1 },
+        { "0 && 7", 0 },
+        { "5 && 0", 0 },
+        { "0 || 7", 1 },
+        { "5 || 0", 1 },
+        { "0 || 0", 0 },
+        { "1 || 0 && 0", 1 },
+        { "(1 || 0) && 0", 0 },
+        { "0 && 1 || 3", 1 },
+        { "(2 || 0) + (0 && 1) + (0 || 4)", 2 },
+        { "0||0||0||0||0||0||0||0||0||0||0||0||0||0||0||0||0||0||0||0||"
+          "0||0||0||0||0||0||0||0||0||0||0||0||0||0||0||0||0||0||0||9", 1 },
+    };
+    static const struct {
+        const char* text;
+        const char* error;
+    } errors[] = {
+        { "a ==", "unexpected end of expression at column 5" },
+        { "1 + foo", "unknown name at column 5" },
+        { "(1 + 2", "expected ')' at column 7" },
+        { "[$10", "expected ']' at column 5" },
+        { "1 2", "unexpected text at column 3" },
+        { "$g", "expected hex digits at column 1" },
+        { "1 + #", "unexpected character at column 5" },
+        { "1+(1+(1+(1+(1+(1+(1+(1+(1+(1+(1+(1+(1+(1+(1+(1+(1+(1+(1+(1+"
+          "(1+(1+(1+(1+(1+(1+(1+(1+(1+(1+(1+(1+1)))))))))))))))))))))))))))))))",
+          "expression too complex at column 128" },
+    };
+
+    int failed = 0;
+    for(const auto& v : values) {
+        Expression e;
+        std::string error;
+        if (!e.Compile(v.text, &error)) {
+            printf("FAIL: %s: %s\n", v.text, error.c_str());
+            failed++;
+            continue;
+        }
+        int32_t result = e.Evaluate(&nes, 0x2000, 9);
+        if (result != v.result) {
+            printf("FAIL: %s = %d, expected %d\n", v.text, result, v.result);
+            failed++;
+        }
+    }
+    for(const auto& v : errors) {
+        Expression e;
+        std::string error;
+        if (e.Compile(v.text, &error) || error != v.error || !e.empty()) {
+            printf("FAIL: %s: got '%s', expected '%s'\n", v.text,
+                   error.c_str(), v.error);
+            failed++;
+        }
+    }
+    if (failed) {
+        printf("%d failed\n", failed);
+        return 1;
+    }
+    printf("SUCCESS!\n");
+    return 0;
+}